@@ -0,0 +1,491 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2014 Thomas Mercier Jr.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "Affinity.hh"
+#include "ChipTable.hh"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <dirent.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+
+
+
+namespace
+{
+   // The first line of a sysfs or procfs file, or an empty string if it cannot be read
+   std::string readLine(const std::string& path)
+   {
+      std::string line;
+      std::ifstream infile(path);
+      if( infile )
+         std::getline(infile, line);
+      return line;
+   }
+
+
+   // A CPU mask as written by the kernel: hexadecimal, in comma separated groups of 32 bits, most
+   // significant first (e.g. "00000000,0000000f")
+   bool parseMask(const std::string& mask, cpu_set_t& cpus)
+   {
+      CPU_ZERO(&cpus);
+      unsigned int bit = 0;
+      bool any = false;
+      for( std::string::const_reverse_iterator it = mask.rbegin(); it != mask.rend(); ++it )
+      {
+         if( *it == ',' )
+            continue;
+
+         const char digit[2] = { *it, '\0' };
+         char* end;
+         const unsigned long nibble = std::strtoul(digit, &end, 16);
+         if( *end != '\0' )
+            return false;
+
+         for( unsigned int i = 0; i < 4; ++i, ++bit )
+         {
+            if( (nibble & (1ul << i)) && bit < CPU_SETSIZE )
+            {
+               CPU_SET(bit, &cpus);
+               any = true;
+            }
+         }
+      }
+      return any;
+   }
+
+
+   // A CPU list as written by the kernel (e.g. "2-3,6"). Empty means no CPUs.
+   cpu_set_t parseList(const std::string& list)
+   {
+      cpu_set_t cpus;
+      CPU_ZERO(&cpus);
+
+      std::size_t pos = 0;
+      while( pos < list.size() )
+      {
+         std::size_t end = list.find(',', pos);
+         if( end == std::string::npos )
+            end = list.size();
+         const std::string range(list.substr(pos, end - pos));
+         pos = end + 1;
+
+         char* rest;
+         const unsigned long first = std::strtoul(range.c_str(), &rest, 10);
+         if( rest == range.c_str() )
+            continue;
+         const unsigned long last = (*rest == '-') ? std::strtoul(rest + 1, nullptr, 10) : first;
+         for( unsigned long c = first; c <= last && c < CPU_SETSIZE; ++c )
+            CPU_SET(c, &cpus);
+      }
+      return cpus;
+   }
+
+
+   std::string formatList(const cpu_set_t& cpus)
+   {
+      std::string list;
+      for( int c = 0; c < CPU_SETSIZE; ++c )
+      {
+         if( !CPU_ISSET(c, &cpus) )
+            continue;
+
+         int last = c;
+         while( last + 1 < CPU_SETSIZE && CPU_ISSET(last + 1, &cpus) )
+            ++last;
+
+         if( !list.empty() )
+            list += ',';
+         list += std::to_string(c);
+         if( last != c )
+            list += '-' + std::to_string(last);
+         c = last;
+      }
+      return list.empty() ? "none" : list;
+   }
+
+
+   // The kernel thread handling irq, when interrupts are threaded: its comm is "irq/N-name"
+   pid_t irqThread(unsigned int irq)
+   {
+      const std::string prefix("irq/" + std::to_string(irq) + "-");
+
+      DIR* const dir = opendir("/proc");
+      if( dir == nullptr )
+         return -1;
+
+      pid_t pid = -1;
+      while( const struct dirent* entry = readdir(dir) )
+      {
+         char* end;
+         const long p = std::strtol(entry->d_name, &end, 10);
+         if( *end != '\0' || p <= 0 )
+            continue;
+
+         const std::string comm(readLine(std::string("/proc/") + entry->d_name + "/comm"));
+         if( comm.compare(0, prefix.size(), prefix) == 0 )
+         {
+            pid = p;
+            break;
+         }
+      }
+      closedir(dir);
+      return pid;
+   }
+
+
+   // topology/cluster_id where the kernel provides it, otherwise the physical package (socket)
+   bool clusterId(unsigned int cpu, std::string& id)
+   {
+      const std::string topology(
+         "/sys/devices/system/cpu/cpu" + std::to_string(cpu) + "/topology/");
+      id = readLine(topology + "cluster_id");
+      if( id.empty() )
+         id = readLine(topology + "physical_package_id");
+      return !id.empty();
+   }
+
+
+   void setThreadAffinity(std::thread& thread, const cpu_set_t& cpus)
+   {
+      if( !thread.joinable() )
+         return;
+
+      const int rc = pthread_setaffinity_np(thread.native_handle(), sizeof(cpus), &cpus);
+      if( rc != 0 )
+      {
+         errno = rc;
+         perror("pthread_setaffinity_np");
+         raiseError("Unable to set CPU affinity of thread");
+      }
+   }
+}
+
+
+
+Result<unsigned int> Affinity::irqOf(unsigned short id)
+{
+   const Result<ChipTable::Chip> chip = ChipTable::instance().find(id);
+   if( !chip )
+      return Result<unsigned int>::failure(chip.error());
+   const std::string hwirq(std::to_string(id - chip.value().base));
+
+   const std::string irqPath("/sys/kernel/irq/");
+   DIR* const dir = opendir(irqPath.c_str());
+   if( dir == nullptr )
+      return Result<unsigned int>::failure(irqPath + " does not exist.");
+
+   unsigned int candidates = 0;
+   unsigned int candidate  = 0;
+   bool         named      = false;
+   while( const struct dirent* entry = readdir(dir) )
+   {
+      char* end;
+      const unsigned long irq = std::strtoul(entry->d_name, &end, 10);
+      if( entry->d_name[0] == '.' || *end != '\0' )
+         continue;
+
+      const std::string base(irqPath + entry->d_name + "/");
+      if( readLine(base + "actions").find("gpiolib") == std::string::npos ||
+          readLine(base + "hwirq") != hwirq )
+         continue;
+
+      // Several gpiochips may each have a GPIO with this offset in use
+      ++candidates;
+      if( readLine(base + "chip_name") == chip.value().label )
+      {
+         candidate = irq;
+         named     = true;
+         break;
+      }
+      candidate = irq;
+   }
+   closedir(dir);
+
+   if( candidates == 0 )
+   {
+      return Result<unsigned int>::failure(
+         "No interrupt found for GPIO " + std::to_string(id) +
+         ". Is it configured to detect transitions?");
+   }
+   if( !named && candidates > 1 )
+   {
+      return Result<unsigned int>::failure(
+         "Unable to tell which of " + std::to_string(candidates) +
+         " interrupts belongs to GPIO " + std::to_string(id));
+   }
+   return candidate;
+}
+
+
+Result<cpu_set_t> Affinity::irqCpus(unsigned int irq)
+{
+   const std::string base("/proc/irq/" + std::to_string(irq) + "/");
+
+   std::string mask(readLine(base + "effective_affinity"));
+   if( mask.empty() )
+      mask = readLine(base + "smp_affinity");
+
+   cpu_set_t cpus;
+   if( !parseMask(mask, cpus) )
+   {
+      return Result<cpu_set_t>::failure(
+         "Unable to read the affinity of IRQ " + std::to_string(irq));
+   }
+   return cpus;
+}
+
+
+cpu_set_t Affinity::clusterOf(unsigned int cpu)
+{
+   cpu_set_t cpus;
+   CPU_ZERO(&cpus);
+   CPU_SET(cpu, &cpus);
+
+   std::string id;
+   if( !clusterId(cpu, id) )
+      return cpus;
+
+   const long ncpus = sysconf(_SC_NPROCESSORS_CONF);
+   for( long c = 0; c < ncpus && c < CPU_SETSIZE; ++c )
+   {
+      std::string other;
+      if( clusterId(c, other) && other == id )
+         CPU_SET(c, &cpus);
+   }
+   return cpus;
+}
+
+
+void Affinity::place(GPIO& gpio, const cpu_set_t& detection, const cpu_set_t& callbacks)
+{
+   setThreadAffinity(gpio._pollThread, detection);
+   setThreadAffinity(gpio._isrThread, callbacks);
+}
+
+
+cpu_set_t Affinity::isolatedCpus()
+{
+   return parseList(readLine("/sys/devices/system/cpu/isolated"));
+}
+
+
+cpu_set_t Affinity::nohzFullCpus()
+{
+   // Contains "(null)" on kernels built with NO_HZ_FULL but booted without nohz_full=
+   return parseList(readLine("/sys/devices/system/cpu/nohz_full"));
+}
+
+
+Result<void> Affinity::isolate(GPIO& gpio, unsigned int cpu)
+{
+   if( cpu >= CPU_SETSIZE )
+      return Result<void>::failure("Invalid CPU " + std::to_string(cpu));
+
+   cpu_set_t cpus;
+   CPU_ZERO(&cpus);
+   CPU_SET(cpu, &cpus);
+
+   const Result<unsigned int> irq = irqOf(gpio.id());
+   if( !irq )
+      return Result<void>::failure(irq.error());
+
+   {
+      const std::string path("/proc/irq/" + std::to_string(irq.value()) + "/smp_affinity_list");
+      std::ofstream affinity(path);
+      if( !affinity.is_open() )
+         return Result<void>::failure("Unable to open " + path);
+      affinity << cpu;
+      affinity.close();
+      if( !affinity )
+         return Result<void>::failure("Unable to route IRQ " + std::to_string(irq.value()) +
+                                      " to CPU " + std::to_string(cpu));
+   }
+
+   const pid_t thread = irqThread(irq.value());
+   if( thread > 0 && sched_setaffinity(thread, sizeof(cpus), &cpus) != 0 )
+   {
+      perror("sched_setaffinity");
+      return Result<void>::failure("Unable to move thread of IRQ " + std::to_string(irq.value()));
+   }
+
+   if( gpio._pollThread.joinable() )
+   {
+      const int rc = pthread_setaffinity_np(gpio._pollThread.native_handle(), sizeof(cpus), &cpus);
+      if( rc != 0 )
+         return Result<void>::failure("Unable to move the detecting thread of GPIO " +
+                                      std::to_string(gpio.id()) + ": " + strerror(rc));
+   }
+
+   return Result<void>();
+}
+
+
+void Affinity::describe(std::ostream& os, GPIO& gpio)
+{
+   os << "GPIO " << gpio.id() << '\n';
+
+   const Result<unsigned int> irq = irqOf(gpio.id());
+   if( irq )
+   {
+      const Result<cpu_set_t> routed = irqCpus(irq.value());
+      os << "   IRQ " << irq.value() << " routed to CPUs "
+         << (routed ? formatList(routed.value()) : routed.error()) << '\n';
+
+      const pid_t thread = irqThread(irq.value());
+      cpu_set_t cpus;
+      if( thread > 0 && sched_getaffinity(thread, sizeof(cpus), &cpus) == 0 )
+         os << "   IRQ thread " << thread << " on CPUs " << formatList(cpus) << '\n';
+      else
+         os << "   IRQ not threaded\n";
+   }
+   else
+   {
+      os << "   " << irq.error() << '\n';
+   }
+
+   const std::pair<const char*, std::thread*> threads[] = {
+      { "detecting thread", &gpio._pollThread },
+      { "callback thread",  &gpio._isrThread } };
+   for( const auto& t : threads )
+   {
+      cpu_set_t cpus;
+      if( t.second->joinable() &&
+          pthread_getaffinity_np(t.second->native_handle(), sizeof(cpus), &cpus) == 0 )
+         os << "   " << t.first << " on CPUs " << formatList(cpus) << '\n';
+      else
+         os << "   no " << t.first << '\n';
+   }
+   os.flush();
+}
+
+
+void Affinity::selfTest(
+   std::ostream& os, unsigned int cpu, std::size_t samples, GPIO::Clock::duration period)
+{
+   const cpu_set_t isolated = isolatedCpus();
+   const cpu_set_t nohzFull = nohzFullCpus();
+   os << "Isolated CPUs:  " << formatList(isolated) << '\n';
+   os << "nohz_full CPUs: " << formatList(nohzFull) << '\n';
+   os << "CPU " << cpu << " is " << (CPU_ISSET(cpu, &isolated) ? "" : "not ") << "isolated, "
+      << (CPU_ISSET(cpu, &nohzFull) ? "" : "not ") << "nohz_full\n";
+
+   std::vector<long long> lateness; // ns
+   lateness.reserve(samples);
+   bool placed   = false;
+   bool realtime = false;
+
+   std::thread probe([&]()
+   {
+      cpu_set_t cpus;
+      CPU_ZERO(&cpus);
+      CPU_SET(cpu, &cpus);
+      placed = (pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus) == 0);
+
+      struct sched_param param;
+      param.sched_priority = sched_get_priority_max(SCHED_FIFO) - 1;
+      realtime = (pthread_setschedparam(pthread_self(), SCHED_FIFO, &param) == 0);
+
+      using std::chrono::duration_cast;
+      using std::chrono::nanoseconds;
+      const long long step = duration_cast<nanoseconds>(period).count();
+
+      struct timespec next;
+      clock_gettime(CLOCK_MONOTONIC, &next);
+      for( std::size_t i = 0; i < samples; ++i )
+      {
+         next.tv_nsec += step;
+         next.tv_sec  += next.tv_nsec / 1000000000;
+         next.tv_nsec %= 1000000000;
+         while( clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, nullptr) == EINTR )
+            ;
+
+         struct timespec now;
+         clock_gettime(CLOCK_MONOTONIC, &now);
+         lateness.push_back((now.tv_sec - next.tv_sec) * 1000000000LL +
+                            (now.tv_nsec - next.tv_nsec));
+      }
+   });
+   probe.join();
+
+   if( !placed )
+      os << "Unable to run on CPU " << cpu << '\n';
+   if( lateness.empty() )
+   {
+      os.flush();
+      return;
+   }
+
+   std::sort(lateness.begin(), lateness.end());
+   long long total = 0;
+   for( const long long l : lateness )
+      total += l;
+
+   // Unpinned, the probe ran wherever the scheduler put it, so the figures say nothing about cpu
+   os << "Wakeup jitter ";
+   if( placed )
+      os << "on CPU " << cpu;
+   else
+      os << "not pinned (ran where the scheduler placed it)";
+   os << (realtime ? " (SCHED_FIFO)" : " (not real-time)")
+      << " over " << lateness.size() << " wakeups:\n"
+      << "   min    " << lateness.front() << " ns\n"
+      << "   mean   " << total / static_cast<long long>(lateness.size()) << " ns\n"
+      << "   99%    " << lateness[lateness.size() * 99 / 100] << " ns\n"
+      << "   99.9%  " << lateness[lateness.size() * 999 / 1000] << " ns\n"
+      << "   max    " << lateness.back() << " ns\n";
+   os.flush();
+}
+
+
+void Affinity::placeNearIrq(GPIO& gpio)
+{
+   const unsigned int irq = irqOf(gpio.id()).orRaise();
+   const cpu_set_t routed = irqCpus(irq).orRaise();
+
+   unsigned int cpu = 0;
+   while( !CPU_ISSET(cpu, &routed) )
+      ++cpu;
+
+   cpu_set_t detection;
+   CPU_ZERO(&detection);
+   CPU_SET(cpu, &detection);
+
+   // Keep callbacks off the detecting CPU, unless it has no other CPU in its cluster
+   cpu_set_t callbacks = clusterOf(cpu);
+   if( CPU_COUNT(&callbacks) > 1 )
+      CPU_CLR(cpu, &callbacks);
+
+   place(gpio, detection, callbacks);
+}
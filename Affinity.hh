@@ -0,0 +1,170 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2014 Thomas Mercier Jr.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef AFFINITY_HH
+#define AFFINITY_HH
+
+#include "GPIO.hh"
+#include "Result.hh"
+
+#include <cstddef>
+#include <ostream>
+
+#include <sched.h>
+
+
+//--------------------------------------------------------------------------------------------------
+/// @class Affinity
+/// @brief Places the threads of input GPIOs on chosen CPUs. On multi-cluster (e.g. big.LITTLE)
+///        systems, transitions are detected with least latency and cross-core cache traffic on the
+///        CPU which takes the GPIO's interrupt, and callback functions are best run elsewhere in
+///        that CPU's cluster.
+///
+/// The interrupt of a GPIO is the one the kernel requested for it, named "gpiolib", when its edge
+/// was set. It is found through /sys/kernel/irq, by its hardware IRQ number (the offset of the
+/// GPIO within its gpiochip) and, if several match, by the name of its interrupt chip, which is
+/// usually the label of the gpiochip. Where it is routed is read from
+/// /proc/irq/N/effective_affinity, or /proc/irq/N/smp_affinity if the kernel does not provide it.
+/// Clusters are read from /sys/devices/system/cpu/cpuN/topology.
+///
+/// For the lowest latency, the detecting thread of a GPIO, its interrupt, and the kernel thread
+/// which handles its interrupt (irq/N-gpiolib, on kernels which thread interrupts) can all be moved
+/// to a CPU isolated from the scheduler (isolcpus=) and from the timer tick (nohz_full=), see
+/// isolate(). selfTest() reports the isolation and measures the wakeup jitter of a CPU.
+///
+/// Usage:
+/// @code
+///    GPIO button(15, GPIO::Edge::BOTH, onButton);
+///    Affinity::placeNearIrq(button);
+/// @endcode
+//--------------------------------------------------------------------------------------------------
+class Affinity
+{
+public:
+   //-----------------------------------------------------------------------------------------------
+   // FUNCTION NAME: irqOf
+   ///
+   /// @brief Find the interrupt of GPIO id. Only exists while the GPIO is exported and configured
+   ///        to detect transitions, and not paused.
+   ///
+   /// @return The IRQ number, or the reason it could not be found.
+   ///
+   //-----------------------------------------------------------------------------------------------
+   static Result<unsigned int> irqOf(unsigned short id);
+
+
+   //-----------------------------------------------------------------------------------------------
+   // FUNCTION NAME: irqCpus
+   ///
+   /// @brief The CPUs to which interrupt irq is routed.
+   ///
+   //-----------------------------------------------------------------------------------------------
+   static Result<cpu_set_t> irqCpus(unsigned int irq);
+
+
+   //-----------------------------------------------------------------------------------------------
+   // FUNCTION NAME: clusterOf
+   ///
+   /// @brief The CPUs of the cluster containing cpu (including cpu). Just cpu if the topology
+   ///        cannot be read.
+   ///
+   //-----------------------------------------------------------------------------------------------
+   static cpu_set_t clusterOf(unsigned int cpu);
+
+
+   //-----------------------------------------------------------------------------------------------
+   // FUNCTION NAME: place
+   ///
+   /// @brief Restrict the thread which detects transitions of gpio to detection, and the thread
+   ///        which calls its callback function to callbacks.
+   ///
+   /// @note Only threads which exist are placed: a callback thread started later by
+   ///       GPIO::setCallback() is not, and a GPIO constructed with GPIO::Mode::NO_THREADS has
+   ///       none.
+   ///
+   //-----------------------------------------------------------------------------------------------
+   static void place(GPIO& gpio, const cpu_set_t& detection, const cpu_set_t& callbacks);
+
+
+   //-----------------------------------------------------------------------------------------------
+   // FUNCTION NAME: placeNearIrq
+   ///
+   /// @brief Place detection on the first CPU to which the interrupt of gpio is routed, and
+   ///        callbacks on the other CPUs of that CPU's cluster (or on the same CPU if it is alone
+   ///        in its cluster).
+   ///
+   //-----------------------------------------------------------------------------------------------
+   static void placeNearIrq(GPIO& gpio);
+
+
+   /// CPUs listed in /sys/devices/system/cpu/isolated (isolcpus=).
+   static cpu_set_t isolatedCpus();
+
+   /// CPUs listed in /sys/devices/system/cpu/nohz_full (nohz_full=).
+   static cpu_set_t nohzFullCpus();
+
+
+   //-----------------------------------------------------------------------------------------------
+   // FUNCTION NAME: isolate
+   ///
+   /// @brief Move the interrupt of gpio, the kernel thread which handles it (if any) and the thread
+   ///        which detects its transitions to cpu. The callback thread is left where it is, so that
+   ///        cpu does no other work.
+   ///
+   /// @return Success, or the first step which failed. Moving the interrupt and its thread
+   ///         requires root (CAP_SYS_NICE and write access to /proc/irq).
+   ///
+   //-----------------------------------------------------------------------------------------------
+   static Result<void> isolate(GPIO& gpio, unsigned int cpu);
+
+
+   //-----------------------------------------------------------------------------------------------
+   // FUNCTION NAME: describe
+   ///
+   /// @brief Write where the interrupt, interrupt thread and threads of gpio currently run.
+   ///
+   //-----------------------------------------------------------------------------------------------
+   static void describe(std::ostream& os, GPIO& gpio);
+
+
+   //-----------------------------------------------------------------------------------------------
+   // FUNCTION NAME: selfTest
+   ///
+   /// @brief Write the isolated and nohz_full CPUs, then measure the wakeup jitter of cpu: a thread
+   ///        on cpu, at real-time priority if permitted, sleeps until each of samples deadlines
+   ///        period apart, and the lateness of its wakeups is reported. If the thread cannot be
+   ///        placed on cpu, it is measured unpinned and reported as such.
+   ///
+   //-----------------------------------------------------------------------------------------------
+   static void selfTest(
+      std::ostream&         os,
+      unsigned int          cpu,
+      std::size_t           samples = 10000,
+      GPIO::Clock::duration period  = std::chrono::milliseconds(1));
+
+private:
+   Affinity() = delete;
+};
+
+#endif
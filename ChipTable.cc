@@ -0,0 +1,347 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2014 Thomas Mercier Jr.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "ChipTable.hh"
+#include "GPIO.hh"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+
+#include <dirent.h>
+#include <limits.h>
+#include <linux/netlink.h>
+#include <stdlib.h>
+#include <sys/poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+
+
+const char ChipTable::RESCAN;
+
+
+ChipTable& ChipTable::instance()
+{
+   static ChipTable table;
+   return table;
+}
+
+
+ChipTable::ChipTable() :
+   _chips(),
+   _netlinkFD(-1),
+   _pipeFD{-1, -1}
+{
+   // A failed scan leaves the table empty, so it is reported by the first find()
+   Result<std::vector<Chip>> chips = scan();
+   if( chips )
+      _chips.swap(chips.value());
+}
+
+
+ChipTable::~ChipTable()
+{
+   if( _pipeFD[1] >= 0 )  close(_pipeFD[1]);
+   if( _monitor.joinable() )  _monitor.join();
+   if( _pipeFD[0] >= 0 )  close(_pipeFD[0]);
+   if( _netlinkFD >= 0 )  close(_netlinkFD);
+}
+
+
+Result<std::vector<ChipTable::Chip>> ChipTable::scan()
+{
+   const std::string sysfsPath("/sys/class/gpio/");
+   DIR* const sysfs = opendir(sysfsPath.c_str());
+   if( sysfs == nullptr )
+   {
+      return Result<std::vector<Chip>>::failure(sysfsPath + " does not exist.");
+   }
+
+   std::vector<Chip> chips;
+
+   while( const struct dirent* entry = readdir(sysfs) )
+   {
+      const std::string dir(sysfsPath + entry->d_name);
+      struct stat stat_buf;
+      if( std::string(entry->d_name).find("gpiochip") == 0 &&
+          stat(dir.c_str(), &stat_buf) == 0 && S_ISDIR(stat_buf.st_mode) )
+      {
+         Chip chip;
+         chip.name = entry->d_name;
+
+         std::ifstream infile(dir + "/base");
+         if( !infile )
+         {
+            closedir(sysfs);
+            return Result<std::vector<Chip>>::failure("Unable to read  " + dir + "/base");
+         }
+         infile >> chip.base;
+         infile.close();
+
+         infile.open(dir + "/ngpio");
+         if( !infile )
+         {
+            closedir(sysfs);
+            return Result<std::vector<Chip>>::failure("Unable to read  " + dir + "/ngpio");
+         }
+         infile >> chip.ngpio;
+         infile.close();
+
+         infile.open(dir + "/label"); // informational only
+         if( infile )
+            std::getline(infile, chip.label);
+         infile.close();
+
+         // The parent device of a chip is on the bus through which the chip is accessed
+         char device[PATH_MAX];
+         chip.slow = realpath((dir + "/device").c_str(), device) != nullptr &&
+                     (strstr(device, "/i2c-") != nullptr ||
+                      strstr(device, "/spi")  != nullptr ||
+                      strstr(device, "/usb")  != nullptr);
+
+         chips.push_back(chip);
+      }
+   }
+
+   closedir(sysfs);
+   return chips;
+}
+
+
+Result<ChipTable::Chip> ChipTable::find(unsigned int id)
+{
+   for( int attempt = 0; attempt < 2; ++attempt )
+   {
+      {
+         std::lock_guard<std::mutex> lck(_mutex);
+         for( const auto& c : _chips )
+         {
+            if( c.contains(id) )
+               return c;
+         }
+      }
+
+      if( attempt == 0 )
+      {
+         const Result<void> r = rescan();
+         if( !r )
+            return Result<Chip>::failure(r.error());
+      }
+   }
+   return Result<Chip>::failure("GPIO " + std::to_string(id) + " is invalid");
+}
+
+
+std::vector<ChipTable::Chip> ChipTable::chips() const
+{
+   std::lock_guard<std::mutex> lck(_mutex);
+   return _chips;
+}
+
+
+void ChipTable::addPin(GPIO* pin)
+{
+   std::lock_guard<std::mutex> lck(_mutex);
+   _pins.push_back(pin);
+}
+
+
+void ChipTable::removePin(GPIO* pin)
+{
+   // A rescan in progress may be about to reattach pin, so wait for it to finish
+   std::lock_guard<std::mutex> rescanLck(_rescanMutex);
+   std::lock_guard<std::mutex> lck(_mutex);
+   _pins.erase(std::remove(_pins.begin(), _pins.end(), pin), _pins.end());
+}
+
+
+Result<void> ChipTable::rescan()
+{
+   // One rescan at a time. Also keeps every GPIO to be reattached below alive, see removePin().
+   std::lock_guard<std::mutex> rescanLck(_rescanMutex);
+
+   Result<std::vector<Chip>> scanned = scan();
+   if( !scanned )
+      return Result<void>::failure(scanned.error());
+   std::vector<Chip>& current = scanned.value();
+
+   std::vector<GPIO*> returned;
+   {
+      std::lock_guard<std::mutex> lck(_mutex);
+
+      auto same = [](const Chip& a, const Chip& b)
+                  { return a.name == b.name && a.base == b.base && a.ngpio == b.ngpio &&
+                           a.slow == b.slow; };
+
+      // Only the GPIOs of chips which actually came or went are marked lost by the table changing
+      for( const auto& old : _chips )
+      {
+         if( std::none_of(current.begin(), current.end(),
+                          [&](const Chip& c) { return same(c, old); }) )
+         {
+            for( GPIO* pin : _pins )
+            {
+               if( old.contains(pin->id()) )
+                  pin->markLost();
+            }
+         }
+      }
+
+      // A chip which was unbound and bound again between two scans leaves the table unchanged, but
+      // its GPIOs were unexported meanwhile, so their value files are stale. Every lost GPIO whose
+      // chip is present is reattached, whether or not its chip came or went.
+      for( GPIO* pin : _pins )
+      {
+         if( std::none_of(current.begin(), current.end(),
+                          [&](const Chip& c) { return c.contains(pin->id()); }) )
+            continue;
+
+         if( !pin->lost() && pin->valueFileReplaced() )
+            pin->markLost();
+         if( pin->lost() )
+            returned.push_back(pin);
+      }
+
+      _chips.swap(current);
+   }
+
+   // GPIO::reattach() takes the configuration mutex of the GPIO, so it is called without _mutex.
+   // A GPIO must never call into the table while holding its own configuration mutex, since a
+   // rescan (holding _rescanMutex) may be waiting for it; see GPIO::setAsync().
+   for( GPIO* pin : returned )
+   {
+      // Remains lost until the chip next returns
+      const Result<void> r = pin->reattach();
+      if( !r )
+         std::cerr << r.error() << std::endl;
+   }
+   return Result<void>();
+}
+
+
+void ChipTable::requestRescan()
+{
+   std::lock_guard<std::mutex> lck(_mutex);
+   if( !_monitor.joinable() )
+      return; // Without the monitor, lost GPIOs are only reattached by a rescan from find()
+
+   if( write(_pipeFD[1], &RESCAN, 1) != 1 )
+      perror("write");
+}
+
+
+void ChipTable::startMonitor()
+{
+   std::lock_guard<std::mutex> lck(_mutex);
+   if( _monitor.joinable() )
+      return;
+
+   _netlinkFD = socket(AF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC, NETLINK_KOBJECT_UEVENT);
+   if( _netlinkFD < 0 )
+   {
+      perror("socket");
+      raiseError("Unable to open uevent netlink socket");
+   }
+
+   struct sockaddr_nl addr;
+   memset(&addr, 0, sizeof(addr));
+   addr.nl_family = AF_NETLINK;
+   addr.nl_pid    = 0;
+   addr.nl_groups = 1; // kernel uevents
+   if( bind(_netlinkFD, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) != 0 )
+   {
+      perror("bind");
+      close(_netlinkFD);
+      _netlinkFD = -1;
+      raiseError("Unable to bind uevent netlink socket");
+   }
+
+   if( pipe(_pipeFD) != 0 )
+   {
+      perror("pipe");
+      raiseError("Unable to create pipe");
+   }
+
+   _monitor = std::thread(&ChipTable::monitorLoop, this);
+}
+
+
+void ChipTable::monitorLoop()
+{
+   struct pollfd fdset[2];
+   memset((void*)fdset, 0, sizeof(fdset));
+   fdset[0].fd     = _netlinkFD;
+   fdset[0].events = POLLIN;
+   fdset[1].fd     = _pipeFD[0];
+   fdset[1].events = POLLIN;
+
+   char buf[8192];
+
+   while( true )
+   {
+      const int rc = poll(fdset, 2, -1);
+      if( rc < 0 )
+      {
+         if( errno == EINTR )
+            continue;
+         perror("poll");
+         return;
+      }
+
+      if( fdset[1].revents != 0 )
+      {
+         // A rescan requested by requestRescan(), or the write end closed by the destructor
+         char cmd;
+         if( (fdset[1].revents & POLLHUP) || read(_pipeFD[0], &cmd, 1) != 1 )
+            return;
+
+         const Result<void> r = rescan();
+         if( !r )
+            std::cerr << "Unable to rescan gpiochips: " << r.error() << std::endl;
+         continue;
+      }
+
+      const ssize_t len = recv(_netlinkFD, buf, sizeof(buf) - 1, 0);
+      if( len <= 0 )
+         continue;
+      buf[len] = '\0';
+
+      // A uevent is "ACTION@DEVPATH" followed by NUL separated KEY=VALUE pairs. Only the addition
+      // and removal of gpiochips matter.
+      const std::string header(buf);
+      const bool add    = header.compare(0, 4, "add@") == 0;
+      const bool remove = header.compare(0, 7, "remove@") == 0;
+      if( (!add && !remove) || header.find("gpiochip") == std::string::npos )
+         continue;
+
+      // Try again on the next uevent
+      const Result<void> r = rescan();
+      if( !r )
+         std::cerr << "Unable to rescan gpiochips: " << r.error() << std::endl;
+   }
+}
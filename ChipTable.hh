@@ -0,0 +1,132 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2014 Thomas Mercier Jr.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef CHIPTABLE_HH
+#define CHIPTABLE_HH
+
+#include "Result.hh"
+#include "Uncopyable.hh"
+
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+class GPIO;
+
+
+//--------------------------------------------------------------------------------------------------
+/// @class ChipTable
+/// @brief Process-wide cache of the gpiochips present in sysfs, and of the GPIO objects which use
+///        them.
+///
+/// The table is scanned once, on first use, rather than every time a GPIO is constructed. If
+/// startMonitor() is called, kernel uevents are monitored through a netlink socket so that the
+/// table follows gpiochips (for example, those of I/O expanders) as they appear and disappear. The
+/// GPIOs of a chip which disappears are marked lost; when the chip returns they are re-exported,
+/// reconfigured and resume operation automatically. So are those of a chip which was unbound and
+/// bound again too quickly for the table to change, which are recognised by their value files
+/// having been replaced, either by a rescan or by the failure of a write.
+//--------------------------------------------------------------------------------------------------
+class ChipTable : private Uncopyable
+{
+public:
+
+   //-----------------------------------------------------------------------------------------------
+   /// @struct Chip
+   /// @brief A gpiochip, as described by /sys/class/gpio/gpiochipN
+   //-----------------------------------------------------------------------------------------------
+   struct Chip
+   {
+      std::string    name;   ///< e.g. "gpiochip32"
+      std::string    label;  ///< Driver provided label
+      unsigned int   base;   ///< First GPIO ID of this chip
+      unsigned int   ngpio;  ///< Number of GPIOs of this chip
+      bool           slow;   ///< Behind a bus (I2C, SPI, USB), so every access takes milliseconds
+
+      bool contains(unsigned int id) const { return base <= id && id < base + ngpio; }
+   };
+
+
+   /// The process-wide table. Scanned on first use.
+   static ChipTable& instance();
+
+
+   //-----------------------------------------------------------------------------------------------
+   // FUNCTION NAME: find
+   ///
+   /// @brief Find the chip providing GPIO id. If no cached chip does, the table is rescanned once,
+   ///        in case the chip appeared since the last scan.
+   ///
+   /// @return The chip, or the reason it could not be found.
+   ///
+   //-----------------------------------------------------------------------------------------------
+   Result<Chip> find(unsigned int id);
+
+
+   //-----------------------------------------------------------------------------------------------
+   // FUNCTION NAME: startMonitor
+   ///
+   /// @brief Start following gpiochips as they appear and disappear. Idempotent.
+   ///
+   //-----------------------------------------------------------------------------------------------
+   void startMonitor();
+
+
+   /// A copy of the cached table.
+   std::vector<Chip> chips() const;
+
+private:
+   friend class GPIO;
+
+   ChipTable();
+   ~ChipTable();
+
+   static Result<std::vector<Chip>> scan();
+
+   Result<void> rescan();
+   void monitorLoop();
+
+   // Called by GPIO, so lost GPIOs can be found and reattached
+   void addPin(GPIO* pin);
+   void removePin(GPIO* pin);
+
+   // Called by GPIO when a write shows that its chip went away, so the GPIO is reattached as soon
+   // as the chip is back. Does nothing unless the monitor is running.
+   void requestRescan();
+
+   static const char RESCAN = 's'; // _monitor command: rescan now
+
+private:
+   std::mutex          _rescanMutex; // held by rescan() throughout, and by removePin()
+   mutable std::mutex  _mutex;
+   std::vector<Chip>   _chips;
+   std::vector<GPIO*>  _pins;
+
+   std::thread _monitor;
+   int         _netlinkFD;
+   int         _pipeFD[2]; // RESCAN commands; closing the write end terminates _monitor
+};
+
+#endif
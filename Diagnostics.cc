@@ -0,0 +1,128 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2014 Thomas Mercier Jr.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "Diagnostics.hh"
+
+#include <iomanip>
+
+
+
+const std::size_t Diagnostics::BUCKETS;
+
+
+Diagnostics::Diagnostics()
+{
+   reset();
+}
+
+
+void Diagnostics::record(const Stage stage, const GPIO::Clock::duration interval)
+{
+   using std::chrono::duration_cast;
+   using std::chrono::nanoseconds;
+   const long long signedNs = duration_cast<nanoseconds>(interval).count();
+   const unsigned long long ns = signedNs > 0 ? signedNs : 0;
+
+   std::size_t bucket = 0;
+   while( bucket + 1 < BUCKETS && (ns >> (bucket + 1)) != 0 )
+      ++bucket;
+
+   Counters& c = _stages[stage];
+   c.count.fetch_add(1, std::memory_order_relaxed);
+   c.totalNs.fetch_add(ns, std::memory_order_relaxed);
+   c.buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+
+   unsigned long long max = c.maxNs.load(std::memory_order_relaxed);
+   while( ns > max && !c.maxNs.compare_exchange_weak(max, ns, std::memory_order_relaxed) )
+      ;
+}
+
+
+Diagnostics::Histogram Diagnostics::histogram(const Stage stage) const
+{
+   const Counters& c = _stages[stage];
+
+   Histogram h;
+   h.count = c.count;
+   h.total = std::chrono::duration_cast<GPIO::Clock::duration>(std::chrono::nanoseconds(c.totalNs));
+   h.max   = std::chrono::duration_cast<GPIO::Clock::duration>(std::chrono::nanoseconds(c.maxNs));
+   for( std::size_t i = 0; i < BUCKETS; ++i )
+      h.buckets[i] = c.buckets[i];
+   return h;
+}
+
+
+void Diagnostics::reset()
+{
+   for( Counters& c : _stages )
+   {
+      c.count   = 0;
+      c.totalNs = 0;
+      c.maxNs   = 0;
+      for( auto& b : c.buckets )
+         b = 0;
+   }
+}
+
+
+const char* Diagnostics::name(const Stage stage)
+{
+   switch( stage )
+   {
+      case READ:     return "poll return -> read";
+      case SINK:     return "read -> enqueue";
+      case HANDOFF:  return "enqueue -> dequeue";
+      case TOTAL:    return "poll return -> callback";
+      case CALLBACK: return "callback duration";
+      default:       return "?";
+   }
+}
+
+
+void Diagnostics::write(std::ostream& os) const
+{
+   using std::chrono::duration_cast;
+   using std::chrono::nanoseconds;
+
+   for( int s = 0; s < STAGES; ++s )
+   {
+      const Histogram h = histogram(static_cast<Stage>(s));
+      os << name(static_cast<Stage>(s)) << ": " << h.count << " samples";
+      if( h.count == 0 )
+      {
+         os << '\n';
+         continue;
+      }
+      os << ", mean " << duration_cast<nanoseconds>(h.total).count() / h.count << " ns"
+         << ", max " << duration_cast<nanoseconds>(h.max).count() << " ns\n";
+
+      for( std::size_t i = 0; i < BUCKETS; ++i )
+      {
+         if( h.buckets[i] == 0 )
+            continue;
+         os << "   >= " << std::setw(12) << (i ? 1ull << i : 0ull) << " ns: " << h.buckets[i] << '\n';
+      }
+   }
+   os.flush();
+}
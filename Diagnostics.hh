@@ -0,0 +1,109 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2014 Thomas Mercier Jr.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef DIAGNOSTICS_HH
+#define DIAGNOSTICS_HH
+
+#include "GPIO.hh"
+#include "Uncopyable.hh"
+
+#include <atomic>
+#include <cstddef>
+#include <ostream>
+
+
+//--------------------------------------------------------------------------------------------------
+/// @class Diagnostics
+/// @brief Per-stage latency histograms of the path from a transition being detected to the
+///        callback function being called, for one input GPIO (see GPIO::enableDiagnostics()).
+///
+/// Each transition is timestamped when poll() returns in the thread which detects it, and again
+/// as it passes each later stage, so that a latency spike can be attributed to a stage without
+/// tracing the kernel. sysfs provides no kernel timestamp of the interrupt itself, so the time
+/// from the interrupt to the wakeup of poll() (the kernel's IRQ handling and scheduling of the
+/// detecting thread) is not measured; it is the part left for ftrace.
+///
+/// Histograms have power-of-two buckets of nanoseconds, and are updated without locks.
+//--------------------------------------------------------------------------------------------------
+class Diagnostics : private Uncopyable
+{
+public:
+   //-----------------------------------------------------------------------------------------------
+   /// @enum Stage
+   /// @brief The measured intervals
+   //-----------------------------------------------------------------------------------------------
+   enum Stage {
+      READ,     ///< poll() returned -> value read from sysfs
+      SINK,     ///< value read -> EdgeSink returned and the transition queued for the callback
+      HANDOFF,  ///< transition queued -> dequeued by the callback thread
+      TOTAL,    ///< poll() returned -> callback function called
+      CALLBACK, ///< duration of the callback function
+      STAGES
+   };
+
+   static const std::size_t BUCKETS = 40; ///< Bucket i holds [2^i, 2^(i+1)) ns; the last, longer
+
+
+   //-----------------------------------------------------------------------------------------------
+   /// @struct Histogram
+   /// @brief A snapshot of one stage
+   //-----------------------------------------------------------------------------------------------
+   struct Histogram
+   {
+      unsigned long         count;
+      GPIO::Clock::duration total;
+      GPIO::Clock::duration max;
+      unsigned long         buckets[BUCKETS];
+   };
+
+
+   Diagnostics();
+
+   /// Record one interval of stage. Called by GPIO.
+   void record(Stage stage, GPIO::Clock::duration interval);
+
+   /// A snapshot of stage.
+   Histogram histogram(Stage stage) const;
+
+   /// Discard everything recorded so far.
+   void reset();
+
+   /// Write every stage as a table of its non-empty buckets.
+   void write(std::ostream& os) const;
+
+   static const char* name(Stage stage);
+
+private:
+   struct Counters
+   {
+      std::atomic<unsigned long>      count;
+      std::atomic<unsigned long long> totalNs;
+      std::atomic<unsigned long long> maxNs;
+      std::atomic<unsigned long>      buckets[BUCKETS];
+   };
+
+   Counters _stages[STAGES];
+};
+
+#endif
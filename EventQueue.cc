@@ -0,0 +1,152 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2014 Thomas Mercier Jr.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "EventQueue.hh"
+#include "Result.hh"
+
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+
+
+namespace
+{
+   std::size_t roundUpToPowerOfTwo(std::size_t n)
+   {
+      std::size_t p = 1;
+      while( p < n )
+         p <<= 1;
+      return p;
+   }
+}
+
+
+EventQueue::EventQueue(std::size_t capacity) :
+   _mask(roundUpToPowerOfTwo(capacity ? capacity : 1) - 1),
+   _cells(new Cell[_mask + 1]),
+   _enqueuePos(0),
+   _dequeuePos(0),
+   _armed(false),
+   _eventFD(-1),
+   _overflows(0)
+{
+   for( std::size_t i = 0; i <= _mask; ++i )
+      _cells[i].sequence.store(i, std::memory_order_relaxed);
+
+   _eventFD = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+   if( _eventFD < 0 )
+   {
+      perror("eventfd");
+      raiseError("Unable to create eventfd for EventQueue");
+   }
+}
+
+
+EventQueue::~EventQueue()
+{
+   if( _eventFD >= 0 )  close(_eventFD);
+}
+
+
+void EventQueue::onEdge(unsigned short id, GPIO::Value value, GPIO::TimePoint when)
+{
+   std::size_t pos = _enqueuePos.load(std::memory_order_relaxed);
+   Cell* cell;
+   while( true )
+   {
+      cell = &_cells[pos & _mask];
+      const std::size_t seq = cell->sequence.load(std::memory_order_acquire);
+      const std::intptr_t dif = static_cast<std::intptr_t>(seq) - static_cast<std::intptr_t>(pos);
+      if( dif == 0 )
+      {
+         // The cell is free; claim it
+         if( _enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed) )
+            break;
+      }
+      else if( dif < 0 )
+      {
+         // The cell still holds an event from one lap ago: full
+         ++_overflows;
+         return;
+      }
+      else
+      {
+         pos = _enqueuePos.load(std::memory_order_relaxed);
+      }
+   }
+
+   cell->event.id    = id;
+   cell->event.value = value;
+   cell->event.when  = when;
+   cell->sequence.store(pos + 1, std::memory_order_release);
+
+   signal();
+}
+
+
+void EventQueue::signal()
+{
+   if( _armed.exchange(true) )
+      return;
+
+   const std::uint64_t one = 1;
+   if( write(_eventFD, &one, sizeof(one)) != sizeof(one) )
+      perror("write");
+}
+
+
+std::size_t EventQueue::drain(Event* const events, const std::size_t max)
+{
+   // Consume the notification before looking at the queue, so that an event pushed after the
+   // queue is found empty writes the eventfd again
+   std::uint64_t count;
+   if( read(_eventFD, &count, sizeof(count)) < 0 && errno != EAGAIN )
+      perror("read");
+   _armed = false;
+
+   std::size_t n = 0;
+   while( n < max )
+   {
+      Cell& cell = _cells[_dequeuePos & _mask];
+      if( cell.sequence.load(std::memory_order_acquire) != _dequeuePos + 1 )
+         break; // Empty, or the next event is still being written (and will signal when it is)
+
+      events[n++] = cell.event;
+      cell.sequence.store(_dequeuePos + _mask + 1, std::memory_order_release);
+      ++_dequeuePos;
+   }
+
+   // Events left behind because max was reached must keep the eventfd readable
+   if( n == max && _cells[_dequeuePos & _mask].sequence.load(std::memory_order_acquire) ==
+                   _dequeuePos + 1 )
+   {
+      signal();
+   }
+
+   return n;
+}
@@ -0,0 +1,132 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2014 Thomas Mercier Jr.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef EVENTQUEUE_HH
+#define EVENTQUEUE_HH
+
+#include "GPIO.hh"
+#include "Uncopyable.hh"
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+
+
+//--------------------------------------------------------------------------------------------------
+/// @class EventQueue
+/// @brief Collects the transitions of any number of input GPIOs into one queue, which a single
+///        consumer (typically the main loop of the program) drains in bulk. No callback function
+///        and no callback thread is involved.
+///
+/// The queue is a bounded, lock-free multi-producer single-consumer ring (after Dmitry Vyukov's
+/// bounded queue): each GPIO pushes from the thread which detects its transitions, and a full queue
+/// drops the new event and counts it. An eventfd becomes readable whenever events are waiting, so
+/// the queue can be watched by the consumer's own poll()/epoll() loop. The eventfd is written only
+/// when the queue goes from drained to not drained, not for every event.
+///
+/// Usage:
+/// @code
+///    EventQueue events;
+///    GPIO a(15, GPIO::Edge::BOTH, events);
+///    GPIO b(14, GPIO::Edge::RISING, events);
+///    ...
+///    // when events.fd() is readable:
+///    EventQueue::Event buf[64];
+///    const std::size_t n = events.drain(buf, 64);
+/// @endcode
+//--------------------------------------------------------------------------------------------------
+class EventQueue : public GPIO::EdgeSink, private Uncopyable
+{
+public:
+   //-----------------------------------------------------------------------------------------------
+   /// @struct Event
+   /// @brief One transition
+   //-----------------------------------------------------------------------------------------------
+   struct Event
+   {
+      unsigned short  id;    ///< GPIO ID
+      GPIO::Value     value; ///< Value after the transition
+      GPIO::TimePoint when;  ///< Time at which the transition was detected
+   };
+
+
+   //-----------------------------------------------------------------------------------------------
+   // FUNCTION NAME: EventQueue (constructor)
+   ///
+   /// @param[in]   capacity  The number of events the queue can hold. Rounded up to a power of two.
+   ///
+   //-----------------------------------------------------------------------------------------------
+   explicit EventQueue(std::size_t capacity = 1024);
+
+   ~EventQueue();
+
+
+   void onEdge(unsigned short id, GPIO::Value value, GPIO::TimePoint when) override;
+
+
+   /// A non-blocking eventfd which is readable while events are waiting. Only drain() reads it.
+   int fd() const { return _eventFD; }
+
+
+   //-----------------------------------------------------------------------------------------------
+   // FUNCTION NAME: drain
+   ///
+   /// @brief Remove up to max events, oldest first. Events of any one GPIO are in the order they
+   ///        were detected. Must only be called from one thread at a time.
+   ///
+   /// @return The number of events stored in events.
+   ///
+   //-----------------------------------------------------------------------------------------------
+   std::size_t drain(Event* events, std::size_t max);
+
+
+   /// Number of events dropped because the queue was full.
+   unsigned long overflows() const { return _overflows; }
+
+private:
+   struct Cell
+   {
+      std::atomic<std::size_t> sequence; // position it may next be written at, plus one once written
+      Event                    event;
+   };
+
+   void signal();
+
+private:
+   const std::size_t       _mask;
+   std::unique_ptr<Cell[]> _cells;
+
+   // The producers' and the consumer's positions are kept on separate cache lines
+   char                     _pad0[64];
+   std::atomic<std::size_t> _enqueuePos;
+   char                     _pad1[64];
+   std::size_t              _dequeuePos; // only accessed by drain()
+   char                     _pad2[64];
+
+   std::atomic<bool>          _armed; // the eventfd has been written since it was last read
+   int                        _eventFD;
+   std::atomic<unsigned long> _overflows;
+};
+
+#endif
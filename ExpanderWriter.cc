@@ -0,0 +1,182 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2014 Thomas Mercier Jr.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "ExpanderWriter.hh"
+#include "GPIO.hh"
+
+#include <iostream>
+#include <map>
+#include <memory>
+
+
+
+ExpanderWriter& ExpanderWriter::forChip(const std::string& chip)
+{
+   static std::mutex mutex;
+   static std::map<std::string, std::unique_ptr<ExpanderWriter>> writers;
+
+   std::lock_guard<std::mutex> lck(mutex);
+   std::unique_ptr<ExpanderWriter>& writer = writers[chip];
+   if( !writer )
+      writer.reset(new ExpanderWriter());
+   return *writer;
+}
+
+
+ExpanderWriter::ExpanderWriter() :
+   _dirty(nullptr),
+   _executing(false),
+   _stop(false),
+   _coalesced(0)
+{
+   _thread = std::thread(&ExpanderWriter::run, this);
+}
+
+
+ExpanderWriter::~ExpanderWriter()
+{
+   {
+      std::lock_guard<std::mutex> lck(_mutex);
+      _stop = true;
+      _cv.notify_one();
+   }
+   if( _thread.joinable() )  _thread.join();
+}
+
+
+void ExpanderWriter::post(const GPIO& pin)
+{
+   // An output already queued will be written with its latest shadow value
+   if( pin._dirty.exchange(true) )
+   {
+      ++_coalesced;
+      return;
+   }
+
+   push(&pin, &pin);
+}
+
+
+void ExpanderWriter::post(const GPIO::Assignment* begin, const GPIO::Assignment* end)
+{
+   // Link the outputs into a chain, most recent first, and push the chain as a whole
+   const GPIO* first = nullptr;
+   const GPIO* last  = nullptr;
+   for( const GPIO::Assignment* a = begin; a != end; ++a )
+   {
+      const GPIO& pin = *a->gpio;
+      if( pin._writer.load() != this )
+         continue;
+
+      if( pin._dirty.exchange(true) )
+      {
+         ++_coalesced;
+         continue;
+      }
+
+      pin._nextDirty = first;
+      first = &pin;
+      if( last == nullptr )
+         last = &pin;
+   }
+
+   if( first != nullptr )
+      push(first, last);
+}
+
+
+void ExpanderWriter::push(const GPIO* const first, const GPIO* const last)
+{
+   const GPIO* top = _dirty.load();
+   do
+   {
+      last->_nextDirty = top;
+   } while( !_dirty.compare_exchange_weak(top, first) );
+
+   // The thread only sleeps when the stack is empty. Taking the mutex orders this notification
+   // after its check of the stack, so the wakeup cannot be lost.
+   if( top == nullptr )
+   {
+      { std::lock_guard<std::mutex> lck(_mutex); }
+      _cv.notify_one();
+   }
+}
+
+
+void ExpanderWriter::cancel(const GPIO& pin)
+{
+   std::unique_lock<std::mutex> lck(_mutex);
+
+   // The batch being written may still refer to pin
+   while( pin._dirty || _executing )
+      _idleCV.wait(lck);
+}
+
+
+void ExpanderWriter::run()
+{
+   std::unique_lock<std::mutex> lck(_mutex);
+   while( true )
+   {
+      while( _dirty.load() == nullptr && !_stop )
+         _cv.wait(lck);
+
+      if( _stop )
+         return;
+
+      const GPIO* batch = _dirty.exchange(nullptr);
+      _executing = true;
+      lck.unlock();
+
+      // Reverse the batch, so that outputs are written in the order they were first posted. No
+      // poster touches _nextDirty of an output while it is still dirty.
+      const GPIO* pin = nullptr;
+      while( batch != nullptr )
+      {
+         const GPIO* const next = batch->_nextDirty;
+         batch->_nextDirty = pin;
+         pin   = batch;
+         batch = next;
+      }
+
+      while( pin != nullptr )
+      {
+         const GPIO* const next = pin->_nextDirty;
+
+         // Cleared before the shadow is read, so a value set after the read queues pin again
+         pin->_dirty = false;
+
+         // Nobody to report to but the user
+         const Result<void> r = pin->tryWriteValue(pin->_shadow);
+         if( !r )
+            std::cerr << r.error() << std::endl;
+
+         pin = next;
+      }
+
+      lck.lock();
+      _executing = false;
+      _idleCV.notify_all();
+   }
+}
@@ -0,0 +1,114 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2014 Thomas Mercier Jr.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef EXPANDERWRITER_HH
+#define EXPANDERWRITER_HH
+
+#include "GPIO.hh"
+#include "Uncopyable.hh"
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+
+
+//--------------------------------------------------------------------------------------------------
+/// @class ExpanderWriter
+/// @brief Writes the outputs of one gpiochip from a dedicated thread. Always used for slow chips
+///        (I2C or SPI I/O expanders, on which every access is a bus transaction taking around a
+///        millisecond), and for other outputs on request (see GPIO::setAsync()).
+///
+/// GPIO::setValue() on such an output only records the new value and returns, so a loop setting a
+/// mixture of SoC and expander outputs is never stalled by the expander. Values posted while the
+/// thread is busy accumulate into a batch, written in one pass per chip, in which only the latest
+/// value of each output is written.
+///
+/// The queue is a lock-free stack of dirty outputs (a Treiber stack, linked through the outputs
+/// themselves), and the thread writes the shadow value of each output it pops. Any number of
+/// threads may post without taking a lock, except to wake the thread when the queue was empty.
+//--------------------------------------------------------------------------------------------------
+class ExpanderWriter : private Uncopyable
+{
+public:
+   /// The writer of gpiochip chip (e.g. "gpiochip496"). Its thread is started on first use.
+   static ExpanderWriter& forChip(const std::string& chip);
+
+   ~ExpanderWriter();
+
+
+   //-----------------------------------------------------------------------------------------------
+   // FUNCTION NAME: post
+   ///
+   /// @brief Queue the shadow value of pin to be written, unless it is already queued.
+   ///
+   //-----------------------------------------------------------------------------------------------
+   void post(const GPIO& pin);
+
+
+   //-----------------------------------------------------------------------------------------------
+   // FUNCTION NAME: post
+   ///
+   /// @brief Queue, as one batch, the outputs of every assignment in [begin, end) to an output of
+   ///        this chip. Assignments to outputs of other chips are ignored. The shadow values must
+   ///        already have been set.
+   ///
+   //-----------------------------------------------------------------------------------------------
+   void post(const GPIO::Assignment* begin, const GPIO::Assignment* end);
+
+
+   //-----------------------------------------------------------------------------------------------
+   // FUNCTION NAME: cancel
+   ///
+   /// @brief Wait until no value is queued for or being written to pin.
+   ///
+   //-----------------------------------------------------------------------------------------------
+   void cancel(const GPIO& pin);
+
+
+   /// Number of queued values replaced by a later value before being written.
+   unsigned long coalesced() const { return _coalesced; }
+
+private:
+   ExpanderWriter();
+
+   void run();
+   void push(const GPIO* first, const GPIO* last);
+
+private:
+   std::mutex              _mutex;
+   std::condition_variable _cv;     // signalled when _dirty becomes non-empty or _stop changes
+   std::condition_variable _idleCV; // signalled when a batch has been written
+
+   std::atomic<const GPIO*> _dirty; // top of the stack of queued outputs, most recent first
+   bool                     _executing;
+   bool                     _stop;
+
+   std::atomic<unsigned long> _coalesced;
+
+   std::thread _thread;
+};
+
+#endif
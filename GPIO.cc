@@ -23,16 +23,29 @@ SOFTWARE.
 */
 
 #include "GPIO.hh"
-
+#include "ChipTable.hh"
+#include "Diagnostics.hh"
+#include "ExpanderWriter.hh"
+#include "OutputScheduler.hh"
+#include "OutputVerifier.hh"
+#include "Realtime.hh"
+#include "SafeState.hh"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
 #include <fstream>
-#include <stdexcept>
 
-#include <boost/exception/diagnostic_information.hpp>
-#include <boost/filesystem.hpp>
+#if GPIO_EXCEPTIONS
+   #include <boost/exception/diagnostic_information.hpp>
+#endif
 
+#include <sys/epoll.h>
 #include <sys/fcntl.h>
 #include <sys/poll.h>
 #include <sys/stat.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
 
 #include <iostream>
 using std::cerr;
@@ -41,114 +54,241 @@ using std::endl;
 
 
 const std::string GPIO::_sysfsPath("/sys/class/gpio/");
+const char        GPIO::RESYNC;
+const char        GPIO::ATTACH;
 
 
 GPIO::GPIO(unsigned short id, Direction direction) :
-   _id(id), _id_str(std::to_string(id)),
-   _direction(direction),
-   _edge(GPIO::Edge::NONE),
-   _isr(std::function<void(Value)>()), // default constructor constructs empty function object
-   _pollThread(std::thread()),         // default constructor constructs non-joinable
-   _pollFD(-1),
-   _isrThread(std::thread()),          // default constructor constructs non-joinable
-   _destructing(false)
+   GPIO(id, direction, GPIO::Edge::NONE, new Handlers(), GPIO::Mode::THREADS) // no callback function, no sink
+{
+   init(false).orRaise();
+}
+
 
+GPIO::GPIO(unsigned short id, Edge edge, std::function<void(Value)> isr, Mode mode):
+   GPIO(id, GPIO::Direction::IN, edge, new Handlers(isr, nullptr), mode)
 {
-   initCommon();
+   init(true).orRaise();
 }
 
 
-GPIO::GPIO(unsigned short id, Edge edge, std::function<void(Value)> isr):
+GPIO::GPIO(
+   unsigned short id, Edge edge, EdgeSink& sink, std::function<void(Value)> isr, Mode mode):
+   GPIO(id, GPIO::Direction::IN, edge, new Handlers(isr, &sink), mode)
+{
+   init(true).orRaise();
+}
+
+
+GPIO::GPIO(unsigned short id, Direction direction, Edge edge, Handlers* handlers, Mode mode) :
    _id(id), _id_str(std::to_string(id)),
-   _direction(GPIO::Direction::IN),
+   _valuePath(_sysfsPath + "gpio" + _id_str + "/value"),
+   _direction(direction),
+   _mode(mode),
    _edge(edge),
-   _isr(isr),
+   _handlers(handlers),
+   _pollEpoch(0),
+   _isrEpoch(0),
    _pollThread(std::thread()), // default constructor constructs non-joinable
    _pollFD(-1),
    _isrThread(std::thread()),  // default constructor constructs non-joinable
-   _destructing(false)
+   _destructing(false),
+   _pipeFD{-1, -1},
+   _epollFD(-1),
+   _paused(false),
+   _last(GPIO::Value::LOW),
+   _timerFD(-1),
+   _held(false),
+   _heldValue(GPIO::Value::LOW),
+   _heldAt(),
+   _glitches(0),
+   _diagnostics(nullptr),
+   _countFaults(false),
+   _pollFaults(0),
+   _isrFaults(0),
+   _valueFD(-1),
+   _shadow('0'),
+   _shadowReads(false),
+   _writer(nullptr),
+   _dirty(false),
+   _nextDirty(nullptr),
+   _exported(false),
+   _lost(false)
+#ifndef LOCKFREE
+   ,
+   _eventHead(0),
+   _eventCount(0)
+#endif
+{}
+
+
+Result<std::unique_ptr<GPIO>> GPIO::create(unsigned short id, Direction direction)
+{
+   std::unique_ptr<GPIO> gpio(
+      new GPIO(id, direction, GPIO::Edge::NONE, new Handlers(), GPIO::Mode::THREADS));
+   const Result<void> r = gpio->init(false);
+   if( !r )
+      return Result<std::unique_ptr<GPIO>>::failure(r.error());
+   return gpio;
+}
+
+
+Result<std::unique_ptr<GPIO>> GPIO::create(
+   unsigned short id, Edge edge, std::function<void(Value)> isr, Mode mode)
+{
+   std::unique_ptr<GPIO> gpio(
+      new GPIO(id, GPIO::Direction::IN, edge, new Handlers(isr, nullptr), mode));
+   const Result<void> r = gpio->init(true);
+   if( !r )
+      return Result<std::unique_ptr<GPIO>>::failure(r.error());
+   return gpio;
+}
+
+
+Result<std::unique_ptr<GPIO>> GPIO::create(
+   unsigned short id, Edge edge, EdgeSink& sink, std::function<void(Value)> isr, Mode mode)
 {
-   initCommon();
+   std::unique_ptr<GPIO> gpio(
+      new GPIO(id, GPIO::Direction::IN, edge, new Handlers(isr, &sink), mode));
+   const Result<void> r = gpio->init(true);
+   if( !r )
+      return Result<std::unique_ptr<GPIO>>::failure(r.error());
+   return gpio;
+}
 
-   //attempt to set edge detection
+
+// Any resources acquired before a failure are released by the destructor, which runs even when a
+// constructor fails here, since the object was fully constructed by the delegated-to constructor.
+Result<void> GPIO::init(const bool detect)
+{
+   Result<void> r = initCommon();
+   if( !r )
+      return r;
+   _exported = true;
+
+   // Keep the value file open for the lifetime of the object, so that setValue() and getValue() are
+   // a single system call each. Inputs which detect transitions have a second descriptor, _pollFD,
+   // because reading a sysfs attribute acknowledges its pending notification.
    {
-      std::ofstream sysfs_edge(_sysfsPath + "gpio" + _id_str + "/edge", std::ofstream::app);
-      if( !sysfs_edge.is_open() )
+      const std::string& path(_valuePath);
+      _valueFD = open(path.c_str(), valueFlags()); // closed in destructor
+      if( _valueFD < 0 )
       {
-         throw std::runtime_error(
-            "Unable to set edge for GPIO " + _id_str + "." +
-            "Are you sure this GPIO can be configured for interrupts?");
+         perror("open");
+         return Result<void>::failure("Unable to open " + path);
       }
-      if     ( _edge == GPIO::Edge::NONE )    sysfs_edge << "none";
-      else if( _edge == GPIO::Edge::RISING )  sysfs_edge << "rising";
-      else if( _edge == GPIO::Edge::FALLING ) sysfs_edge << "falling";
-      else if( _edge == GPIO::Edge::BOTH )    sysfs_edge << "both";
-      sysfs_edge.close();
    }
 
+   if( detect )
+   {
+      r = initEdge();
+      if( !r )
+         return r;
+   }
 
-   // It is valid to use the this pointer in the constructor in this case
-   // http://www.parashift.com/c++-faq/using-this-in-ctors.html
-   _isrThread = std::thread(&GPIO::isrLoop, this);
-
-   _pollThread = std::thread(&GPIO::pollLoop, this);
-
-   sched_yield();
+   ChipTable::instance().addPin(this);
+   return Result<void>();
 }
 
 
-void GPIO::initCommon() const
+Result<void> GPIO::initEdge()
 {
-   //validate id #
+   Result<void> r = writeEdge(_edge);
+   if( !r )
+      return r;
+
+   // No easy way to get file descriptor from ifstream... ugh.
+   {
+      const std::string& path(_valuePath);
+      _pollFD = open(path.c_str(), O_RDONLY | O_NONBLOCK); // closed in destructor
+      if( _pollFD < 0 )
+      {
+         perror("open");
+         return Result<void>::failure("Unable to open " + path);
+      }
+   }
+
+   // There is no way to have poll() come out of a blocking state except when it detects activity on
+   // file descriptors it is monitoring, or when a process/thread blocked in poll() receives a
+   // signal. Because this thread will not terminate unless poll() comes out of a blocking state at
+   // some point, we need a mechanism to kick poll() out of its blocking state, even if no activity
+   // is detected on the file descriptor of interest, _pollFD. I have chosen to use a pipe to
+   // to acquire a stream type file descriptor which poll() will monitor for activity. Single byte
+   // commands written to the pipe ask _pollThread to do work on behalf of other threads, and closing
+   // the write end of the pipe asks it to terminate.
    {
-      if( !boost::filesystem::exists(_sysfsPath) )
+      if( pipe(_pipeFD) != 0 )
       {
-         throw std::runtime_error(_sysfsPath + " does not exist.");
+         perror("pipe");
+         return Result<void>::failure("Unable to create pipe");
       }
+   }
 
-      using boost::filesystem::directory_iterator;
-      const directory_iterator end_itr; // default construction yields past-the-end
+   // Read here rather than by _pollThread, so that a failure is reported to the caller (and by
+   // create()) instead of ending the process from a thread
+   r = readInitial();
+   if( !r )
+      return r;
 
-      bool found = false;
-      for( directory_iterator itr(_sysfsPath); itr != end_itr; ++itr)
+   // Without threads, both file descriptors are watched through one epoll instance, which is
+   // readable whenever processEvents() has work to do
+   if( _mode == GPIO::Mode::NO_THREADS )
+   {
+      _epollFD = epoll_create1(EPOLL_CLOEXEC);
+      if( _epollFD < 0 )
       {
-         if( is_directory(itr->status()) &&
-             itr->path().string().find("gpiochip") != std::string::npos )
-         {
-            std::ifstream infile(itr->path().string() + "/base");
-            if( !infile )
-            {
-               throw std::runtime_error("Unable to read  " + itr->path().string() + "/base");
-            }
-
-            // There is no way to be fast and const-correct here :(
-            // http://insanecoding.blogspot.com/2011/11/how-to-read-in-file-in-c.html
-            std::string base;
-            infile >> base;
-            infile.close();
-
-            infile.open(itr->path().string() + "/ngpio");
-            if( !infile )
-            {
-               throw std::runtime_error("Unable to read  " + itr->path().string() + "/ngpio");
-            }
-
-            std::string ngpio;
-            infile >> ngpio;
-            infile.close();
-
-            // GPIO id is valid
-            if( std::stoul(base) <= _id && _id < std::stoul(base) + std::stoul(ngpio) )
-            {
-               found = true;
-               break;
-            }
-         }
+         perror("epoll_create1");
+         return Result<void>::failure("Unable to create epoll instance");
+      }
+
+      struct epoll_event event;
+      memset(&event, 0, sizeof(event));
+      event.events = EPOLLIN;
+      if( epoll_ctl(_epollFD, EPOLL_CTL_ADD, _pipeFD[0], &event) != 0 )
+      {
+         perror("epoll_ctl");
+         return Result<void>::failure("Unable to watch pipe of GPIO " + _id_str);
+      }
+
+      // Stands in for the poll() timeout of _pollThread, see filterPulse()
+      _timerFD = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+      if( _timerFD < 0 )
+      {
+         perror("timerfd_create");
+         return Result<void>::failure("Unable to create timer for GPIO " + _id_str);
       }
-      if( !found )
+      if( epoll_ctl(_epollFD, EPOLL_CTL_ADD, _timerFD, &event) != 0 )
       {
-         throw std::runtime_error("GPIO " + _id_str + " is invalid");
+         perror("epoll_ctl");
+         return Result<void>::failure("Unable to watch timer of GPIO " + _id_str);
       }
+      watch(true);
+
+      return Result<void>();
+   }
+
+   // It is valid to use the this pointer in the constructor in this case
+   // http://www.parashift.com/c++-faq/using-this-in-ctors.html
+   if( _handlers.load()->isr )
+      _isrThread = std::thread(&GPIO::isrLoop, this);
+
+   _pollThread = std::thread(&GPIO::pollLoop, this);
+
+   sched_yield();
+   return Result<void>();
+}
+
+
+Result<void> GPIO::initCommon()
+{
+   //validate id #
+   {
+      const Result<ChipTable::Chip> chip = ChipTable::instance().find(_id);
+      if( !chip )
+         return Result<void>::failure(chip.error());
+
+      if( chip.value().slow && _direction == GPIO::Direction::OUT )
+         _writer = &ExpanderWriter::forChip(chip.value().name);
    }
 
 
@@ -160,7 +300,7 @@ void GPIO::initCommon() const
       const std::string path(_sysfsPath + "gpio" + _id_str);
       if( stat(path.c_str() , &stat_buf) == 0 )
       {
-         throw std::runtime_error(
+         return Result<void>::failure(
             "GPIO " + _id_str + " already exported." +
             "(Some other GPIO object already owns this GPIO)");
       }
@@ -168,12 +308,18 @@ void GPIO::initCommon() const
 
 
 
+   return configure('0');
+}
+
+
+Result<void> GPIO::configure(const char value) const
+{
    // attempt to export
    {
       std::ofstream sysfs_export(_sysfsPath + "export", std::ofstream::app);
       if( !sysfs_export.is_open() )
       {
-         throw std::runtime_error("Unable to export GPIO " + _id_str);
+         return Result<void>::failure("Unable to export GPIO " + _id_str);
       }
       sysfs_export << _id_str;
       sysfs_export.close();
@@ -187,7 +333,7 @@ void GPIO::initCommon() const
          _sysfsPath + "gpio" + _id_str + "/direction", std::ofstream::app);
       if( !sysfs_direction.is_open() )
       {
-         throw std::runtime_error("Unable to set direction for GPIO " + _id_str);
+         return Result<void>::failure("Unable to set direction for GPIO " + _id_str);
       }
       if( _direction == GPIO::Direction::IN )        sysfs_direction << "in";
       else if( _direction == GPIO::Direction::OUT )  sysfs_direction << "out";
@@ -201,7 +347,7 @@ void GPIO::initCommon() const
       std::ofstream sysfs_activelow(_sysfsPath + "gpio" + _id_str + "/active_low", std::ofstream::app);
       if( !sysfs_activelow.is_open() )
       {
-         throw std::runtime_error("Unable to clear active_low for GPIO " + _id_str);
+         return Result<void>::failure("Unable to clear active_low for GPIO " + _id_str);
       }
       sysfs_activelow << "0";
       sysfs_activelow.close();
@@ -209,270 +355,1098 @@ void GPIO::initCommon() const
 
 
 
-   //if output, set value to inactive
+   //if output, set initial value
    {
       if( _direction == GPIO::Direction::OUT )
       {
          std::ofstream sysfs_value(_sysfsPath + "gpio" + _id_str + "/value", std::ofstream::app);
          if( !sysfs_value.is_open() )
          {
-            throw std::runtime_error("Unable to initialize value for GPIO " + _id_str);
+            return Result<void>::failure("Unable to initialize value for GPIO " + _id_str);
          }
-         sysfs_value << "0";
+         sysfs_value << value;
          sysfs_value.close();
       }
    }
+
+   return Result<void>();
 }
 
 
-void GPIO::pollLoop()
+Result<void> GPIO::readInitial()
 {
-   // No easy way to get file descriptor from ifstream... ugh.
+   const int MAX_BUF = 2; // either 1 or 0 plus EOL
+   char buf[MAX_BUF];
+
+   /// Consume the initial value
+   const ssize_t nbytes = read(_pollFD, buf, MAX_BUF);
+   if( nbytes != MAX_BUF )
    {
-      const std::string path(_sysfsPath + "gpio" + _id_str + "/value");
-      _pollFD = open(path.c_str(), O_RDONLY | O_NONBLOCK); // closed in destructor
-      if( _pollFD < 0 )
-      {
-         perror("open");
-         throw std::runtime_error("Unable to open " + path);
-      }
+      // It is possible that read() could:
+      //  return 1 (which could be recovered from)
+      //  return 0 (which could be recovered from in the case no errors are detected)
+      //  return < 0 (which could not be recovered from)
+      // I suspect these cases are extraordinarily rare, and do not currently consider them to be
+      // worth the amount of code necessary to gracefully recover, or the possibility of
+      // introducing bugs in that code. No occurrences have been observed in over 1 year of
+      // continuous operation, but I'm still willing to be wrong; just contact me if you see the
+      // error below, want to make the argument that the code is necessary, or can provide said
+      // code. :) This also applies to the read() in readValue().
+      if( nbytes < 0 ) perror("read1");
+      return Result<void>::failure("GPIO " + _id_str + " read1() badness...");
    }
 
-   // There is no way to have poll() come out of a blocking state except when it detects activity on
-   // file descriptors it is monitoring, or when a process/thread blocked in poll() receives a
-   // signal. Because this thread will not terminate unless poll() comes out of a blocking state at
-   // some point, we need a mechanism to kick poll() out of its blocking state, even if no activity
-   // is detected on the file descriptor of interest, _pollFD. I have chosen to use a pipe to
-   // to acquire a stream type file descriptor which poll() will monitor for activity. I will not
-   // cause any activity to occur on this file descriptor until I wish to terminate the thread.
+   _last = (buf[0] == '1') ? GPIO::Value::HIGH : GPIO::Value::LOW;
+
+   ReadSection section(_pollEpoch);
+   const Handlers* const h = _handlers.load();
+   if( h->sink != nullptr && (buf[0] == '0' || buf[0] == '1') )
    {
-      if( pipe(_pipeFD) != 0 )
-      {
-         perror("pipe");
-         throw std::runtime_error("Unable to create pipe");
-      }
+      h->sink->onInitial(_id, _last, Clock::now());
    }
+   return Result<void>();
+}
 
 
-   const int MAX_BUF = 2; // either 1 or 0 plus EOL
-   char buf[MAX_BUF];
-   struct pollfd fdset[2];
-
-   memset((void*)fdset, 0, sizeof(fdset));
+void GPIO::pollLoop()
+{
+   Realtime::prefaultStack();
 
-   fdset[0].fd     = _pollFD;
-   fdset[0].events = POLLPRI;
+   struct pollfd fdset[2];
+   initPollSet(fdset);
 
-   fdset[1].fd     = _pipeFD[0]; // This is the FD for the read end of the pipe
-   fdset[1].events = POLLRDHUP; // Monitor for closed connection
+   FaultCounter faults(_pollFaults, _countFaults);
 
-   /// Consume the initial value
+   while( !_destructing )
    {
-      const ssize_t nbytes = read(fdset[0].fd, buf, MAX_BUF);
-      if( nbytes != MAX_BUF )
+      // An EdgeSink may need to be woken periodically even if no transitions occur
+      Clock::duration timeout = Clock::duration::max();
+      Clock::duration width;
       {
-         // It is possible that read() could:
-         //  return 1 (which could be recovered from)
-         //  return 0 (which could be recovered from in the case no errors are detected)
-         //  return < 0 (which could not be recovered from)
-         // I suspect these cases are extraordinarily rare, and do not currently consider them to be
-         // worth the amount of code necessary to gracefully recover, or the possibility of
-         // introducing bugs in that code. No occurrences have been observed in over 1 year of
-         // continuous operation, but I'm still willing to be wrong; just contact me if you see the
-         // error below, want to make the argument that the code is necessary, or can provide said
-         // code. :) This also applies to the read() in the loop below.
-         if( nbytes < 0 ) perror("read1");
-         throw std::runtime_error("GPIO " + _id_str + " read1() badness...");
+         ReadSection section(_pollEpoch);
+         const Handlers* const h = _handlers.load();
+         if( h->sink != nullptr )
+            timeout = h->sink->idleTimeout();
+         width = h->minPulseWidth;
       }
-   }
 
-
-
-
-   while( !_destructing )
-   {
-      const int rc = poll(fdset, 2, -1);
-      if( rc == 1 )
+      // A held transition is decided once it has lasted the minimum pulse width
+      bool due = false;
+      if( _held )
       {
-         if(fdset[0].revents & POLLPRI)
+         const Clock::duration left =
+            std::max(Clock::duration::zero(), _heldAt + width - Clock::now());
+         if( left <= timeout )
          {
-            /// Consume the new value
-            lseek(fdset[0].fd, 0, SEEK_SET);
-            const ssize_t nbytes = read(fdset[0].fd, buf, MAX_BUF);
-            if( nbytes != MAX_BUF ) // See comment above
-            {
-               if( nbytes < 0 )
-                  perror("read2");
-
-               throw std::runtime_error("GPIO " + _id_str + " read2() badness...");
-            }
-
-
-            Value val;
-            if     ( buf[0] == '0' )  val = GPIO::Value::LOW;
-            else if( buf[0] == '1' )  val = GPIO::Value::HIGH;
-            else throw std::runtime_error("Invalid value read from GPIO " + _id_str + ": " + buf[0]);
-
-   #ifdef LOCKFREE
-            while( !_spsc_queue.push(val) )
-               ;
-   #else
-            {
-               std::lock_guard<std::mutex> lck(_eventMutex);
-               _eventQueue.push(val);
-               _eventCV.notify_one();
-            }
-   #endif
-
+            timeout = left;
+            due     = true;
          }
-         else // POLLRDHUP must have occurred, so end the thread
-         { return; }
       }
-      else if( rc < 0 )
+
+      int rc;
+      if( timeout == Clock::duration::max() )
+      {
+         rc = poll(fdset, 2, -1);
+      }
+      else
+      {
+         using std::chrono::duration_cast;
+         using std::chrono::nanoseconds;
+         using std::chrono::seconds;
+         const nanoseconds ns = duration_cast<nanoseconds>(timeout);
+         struct timespec ts;
+         ts.tv_sec  = duration_cast<seconds>(ns).count();
+         ts.tv_nsec = (ns - seconds(ts.tv_sec)).count();
+         rc = ppoll(fdset, 2, &ts, nullptr);
+      }
+      const TimePoint now = Clock::now();
+
+      if( rc < 0 )
       {
          if( errno == EINTR )
             continue;
 
          perror("poll");
-         throw std::runtime_error("poll() error on GPIO " + _id_str);
+         raiseError("poll() error on GPIO " + _id_str);
       }
       else if( rc == 0 )
       {
-         using std::runtime_error;
-         throw runtime_error("poll() return code indicates timeout, which should never happen.");
+         if( due )
+         {
+            releaseHeld(fdset[0]);
+            faults.update();
+            continue;
+         }
+
+         ReadSection section(_pollEpoch);
+         const Handlers* const h = _handlers.load();
+         if( h->sink == nullptr )
+         {
+            raiseError("poll() return code indicates timeout, which should never happen.");
+         }
+         h->sink->onIdle(_id, now);
+         continue;
       }
-      else if( rc > 1 ) // POLLRDHUP must have occurred, so end the thread
-      { return; }
+
+      // The write end of the pipe is closed by the destructor, so end the thread
+      if( !handleEvents(fdset, now) )
+         return;
+
+      faults.update();
    }
 }
 
-// Process interrupt events serially
-void GPIO::isrLoop()
+
+void GPIO::initPollSet(struct pollfd* fdset) const
 {
-   Value val;
+   memset((void*)fdset, 0, 2 * sizeof(*fdset));
 
-   while(1)
+   fdset[0].fd     = _lost ? -1 : _pollFD;
+   fdset[0].events = POLLPRI;
+
+   fdset[1].fd     = _pipeFD[0]; // This is the FD for the read end of the pipe
+   fdset[1].events = POLLIN;     // Commands. POLLHUP (closed write end) is always reported.
+}
+
+
+bool GPIO::handleEvents(struct pollfd* fdset, const TimePoint now)
+{
+   const int MAX_BUF = 2; // either 1 or 0 plus EOL
+   char buf[MAX_BUF];
+
+   if( fdset[1].revents != 0 )
    {
-#ifdef LOCKFREE
-      //!***************************************** BEWARE ****************************************!/
-      /// On the BeagleBone, this loop is effectively a spinlock. Unless there is a lot of GPIO
-      /// activity it will be EXTREMELY wasteful of CPU time!!! (It is guaranteed to waste an entire
-      /// quantum if not immediately successful at obtaining a value.) On Multicore systems this
-      /// approach should provide slightly lower latency than mutexes and condition variables at the
-      /// expense of CPU time. On the BeagleBone Black, it provides about 0.5 ms lower latency, but
-      /// nowhere near what the BeagleBone Black PRUs can provide (nanoseconds), or even what a
-      /// kernel module can provide (microseconds).
-      //!*****************************************************************************************!/
-      while( !_spsc_queue.pop(val) )
-         if( _destructing )
-            return;
-#else
-      std::unique_lock<std::mutex> lck(_eventMutex);
-      while( _eventQueue.empty() )
+      char cmd;
+      if( (fdset[1].revents & POLLHUP) || read(_pipeFD[0], &cmd, 1) != 1 )
+         return false;
+
+      if( cmd == ATTACH )
       {
-         _eventCV.wait(lck);
+         // The chip has returned and this GPIO has been exported again. The old value file
+         // belongs to the departed chip, so replace it without changing the descriptor number.
+         const std::string& path(_valuePath);
+         const int fd = open(path.c_str(), O_RDONLY | O_NONBLOCK);
+         if( fd < 0 )
+         {
+            perror("open");
+            return true; // Remains lost
+         }
+         dup2(fd, _pollFD);
+         close(fd);
 
-         if( _destructing == true )
-            return;
+         fdset[0].fd = _pollFD;
+         watch(true);
+         _lost = false;
+         cmd = RESYNC;
       }
 
+      if( cmd == RESYNC && !_lost )
+      {
+         // Report a level change which was missed while paused or lost, if it is one of the
+         // transitions this GPIO reports
+         Value val;
+         if( !readValue(buf, MAX_BUF, val) )
+         {
+            goLost(fdset[0]);
+            return true;
+         }
+
+         const Edge  edge = _edge;
+         if( val != _last &&
+             (edge == GPIO::Edge::BOTH ||
+              (edge == GPIO::Edge::RISING  && val == GPIO::Value::HIGH) ||
+              (edge == GPIO::Edge::FALLING && val == GPIO::Value::LOW)) )
+         {
+            filterPulse(val, now);
+         }
+         _last = val;
+      }
+   }
 
-      val = _eventQueue.front();
-      _eventQueue.pop();
-      lck.unlock();
-#endif
+   if( fdset[0].revents & (POLLPRI | POLLERR) )
+   {
+      /// Consume the new value
+      Value val;
+      if( !readValue(buf, MAX_BUF, val) )
+      {
+         goLost(fdset[0]);
+         return true;
+      }
+      if( Diagnostics* const diagnostics = _diagnostics.load(std::memory_order_relaxed) )
+         diagnostics->record(Diagnostics::READ, Clock::now() - now);
 
-      /// *************************************************************
-      /// If this (user) function causes an exception to be thrown,
-      /// it will not be handled or ignored!!!
-      /// *************************************************************
-      _isr(val);
+      // Transitions which the kernel detected before it was told to stop are discarded. _last is
+      // left alone, so that a level change among them is still reported by the RESYNC of resume().
+      if( !_paused )
+      {
+         _last = val;
+         filterPulse(val, now);
+      }
    }
-}
 
+   return true;
+}
 
 
-GPIO::~GPIO()
+void GPIO::processEvents()
 {
-   // Set this flag to true in order to indicate to _isrThread that it needs to terminate
-   _destructing = true;
-#ifndef LOCKFREE
-   _eventCV.notify_one();
-#endif
+   if( _mode != GPIO::Mode::NO_THREADS )
+   {
+      raiseError("GPIO " + _id_str + " was not constructed for use without threads");
+   }
 
-   // Close the file descriptors for this pipe to trigger a POLLRDHUP event, which will cause
-   // _pollThread to terminate
-   close(_pipeFD[0]);
-   close(_pipeFD[1]);
+   struct pollfd fdset[2];
+   initPollSet(fdset);
 
-   if( _isrThread.joinable() )   _isrThread.join();
-   if( _pollThread.joinable() )  _pollThread.join();
+   const int rc = poll(fdset, 2, 0);
+   if( rc < 0 && errno != EINTR )
+   {
+      perror("poll");
+      raiseError("poll() error on GPIO " + _id_str);
+   }
 
-   // Do not close the file descriptor for the sysfs value file until _pollThread() has joined.
-   // This prevents reuse of this file descriptor by the kernel for other threads in this
-   // process while the descriptor is still in use in the poll() system call.
-   close(_pollFD);
+   if( rc > 0 )
+      handleEvents(fdset, Clock::now());
 
-   // attempt to unexport
-   try
+   // The timer is only read to make fd() unreadable again; the due time is checked below
+   std::uint64_t expirations;
+   if( read(_timerFD, &expirations, sizeof(expirations)) < 0 && errno != EAGAIN )
+      perror("read");
+
+   if( _held )
    {
-      std::ofstream sysfs_unexport(_sysfsPath + "unexport", std::ofstream::app);
-      if( sysfs_unexport.is_open() )
+      Clock::duration width;
       {
-         sysfs_unexport << _id_str;
-         sysfs_unexport.close();
+         ReadSection section(_pollEpoch);
+         width = _handlers.load()->minPulseWidth;
       }
-      else // Do not throw exception in destructor! Effective C++ Item 8.
+
+      const Clock::duration left = _heldAt + width - Clock::now();
+      if( left <= Clock::duration::zero() )
+         releaseHeld(fdset[0]);
+      else
+         armTimer(left); // The width may have changed since the timer was set
+   }
+}
+
+
+void GPIO::filterPulse(const Value val, const TimePoint when)
+{
+   Clock::duration width;
+   {
+      ReadSection section(_pollEpoch);
+      width = _handlers.load()->minPulseWidth;
+   }
+
+   if( !_held )
+   {
+      if( width == Clock::duration::zero() )
       {
-         cerr << "Unable to unexport GPIO " + _id_str + "!" << endl;
-         cerr << "This will prevent initialization of another GPIO object for this GPIO." << endl;
+         deliver(val, when);
+         return;
       }
+
+      // Decided by releaseHeld() once width has elapsed, unless the level changes back first
+      _held      = true;
+      _heldValue = val;
+      _heldAt    = when;
+      armTimer(width);
+      return;
    }
-   catch(...)
+
+   // The level changed back before the held transition had lasted width: drop both. A repeated
+   // report of the held level (its intervening transitions were missed) changes nothing.
+   if( val != _heldValue )
    {
-      cerr << "Exception caught in destructor for GPIO " << _id_str << endl;
-      cerr << boost::current_exception_diagnostic_information() << endl;
+      _held = false;
+      armTimer(Clock::duration::zero());
+      ++_glitches;
    }
 }
 
 
-void GPIO::setValue(const Value value) const
+void GPIO::releaseHeld(struct pollfd& fdset)
 {
-   if( _direction == GPIO::Direction::IN )
-   {
-      throw std::runtime_error("Cannot set value on an input GPIO");
-   }
+   _held = false;
 
-   std::ofstream sysfs_value(_sysfsPath + "gpio" + _id_str + "/value", std::ofstream::app);
-   if( !sysfs_value.is_open() )
+   // The transition back may not be reported at all (e.g. with Edge::RISING), so the level decides
+   const int MAX_BUF = 2; // either 1 or 0 plus EOL
+   char buf[MAX_BUF];
+   Value val;
+   if( !readValue(buf, MAX_BUF, val) )
    {
-      throw std::runtime_error("Unable to set value for GPIO " + _id_str);
+      goLost(fdset);
+      return;
    }
+   _last = val;
+
+   if( val != _heldValue )
+      ++_glitches;
+   else if( !_paused )
+      deliver(_heldValue, _heldAt);
+}
 
-   if     ( value == GPIO::Value::HIGH )  sysfs_value << "1";
-   else if( value == GPIO::Value::LOW )   sysfs_value << "0";
-   sysfs_value.close();
+
+void GPIO::armTimer(const Clock::duration timeout) const
+{
+   if( _timerFD < 0 )
+      return;
+
+   // A zero timeout disarms the timer
+   using std::chrono::duration_cast;
+   using std::chrono::nanoseconds;
+   using std::chrono::seconds;
+   const nanoseconds ns = duration_cast<nanoseconds>(timeout);
+
+   struct itimerspec its;
+   memset(&its, 0, sizeof(its));
+   its.it_value.tv_sec  = duration_cast<seconds>(ns).count();
+   its.it_value.tv_nsec = (ns - seconds(its.it_value.tv_sec)).count();
+   if( timerfd_settime(_timerFD, 0, &its, nullptr) != 0 )
+      perror("timerfd_settime");
 }
 
 
-GPIO::Value GPIO::getValue() const
+void GPIO::watch(const bool watching)
 {
-   std::ifstream sysfs_value(_sysfsPath + "gpio" + _id_str + "/value");
-   if( !sysfs_value.is_open() )
+   if( _epollFD < 0 )
+      return;
+
+   // A value file whose chip has gone reports POLLERR until it is closed, which would keep fd()
+   // readable. Its registration is also dropped by the kernel when dup2() replaces it.
+   epoll_ctl(_epollFD, EPOLL_CTL_DEL, _pollFD, nullptr);
+   if( watching )
    {
-      throw std::runtime_error("Unable to get value for GPIO " + _id_str);
+      struct epoll_event event;
+      memset(&event, 0, sizeof(event));
+      event.events = EPOLLPRI;
+      if( epoll_ctl(_epollFD, EPOLL_CTL_ADD, _pollFD, &event) != 0 )
+         perror("epoll_ctl");
    }
+}
 
-   const char value = sysfs_value.get();
-   if( !sysfs_value.good() )
+
+void GPIO::goLost(struct pollfd& fdset)
+{
+   // A read failure is only survivable if the chip providing this GPIO has gone away, possibly to
+   // return at once (in which case a rescan may already have marked it lost)
+   if( !_lost && !chipRemoved() && !valueFileReplaced() )
    {
-      throw std::runtime_error("Unable to get value for GPIO " + _id_str);
+      raiseError("GPIO " + _id_str + " read2() badness...");
    }
 
-   Value val;
-   if     ( value == '0' )  val = GPIO::Value::LOW;
-   else if( value == '1' )  val = GPIO::Value::HIGH;
-   else throw std::runtime_error("Invalid value read from GPIO " + _id_str + ": " + value);
+   // Stop polling the value file until the chip returns, see ChipTable
+   _lost = true;
+   fdset.fd = -1;
+   watch(false);
+
+   // The level cannot be checked again until the chip returns
+   _held = false;
+   armTimer(Clock::duration::zero());
+}
+
+
+bool GPIO::readValue(char* buf, const int len, Value& val) const
+{
+   lseek(_pollFD, 0, SEEK_SET);
+   const ssize_t nbytes = read(_pollFD, buf, len);
+   if( nbytes != len ) // See comment in pollLoop()
+   {
+      if( nbytes < 0 && !chipRemoved() )
+         perror("read2");
+
+      return false;
+   }
+
+   if     ( buf[0] == '0' )  val = GPIO::Value::LOW;
+   else if( buf[0] == '1' )  val = GPIO::Value::HIGH;
+   else raiseError("Invalid value read from GPIO " + _id_str + ": " + buf[0]);
+
+   return true;
+}
+
+
+bool GPIO::chipRemoved() const
+{
+   // The kernel removes the GPIO directory when it unexports a GPIO of a departing chip
+   struct stat stat_buf;
+   const std::string path(_sysfsPath + "gpio" + _id_str);
+   return stat(path.c_str(), &stat_buf) != 0;
+}
+
+
+bool GPIO::valueFileReplaced() const
+{
+   // A GPIO exported again (after its chip was unbound and bound again) has a new value file
+   struct stat opened;
+   struct stat current;
+   return fstat(_valueFD, &opened) != 0 || stat(_valuePath.c_str(), &current) != 0 ||
+          opened.st_dev != current.st_dev || opened.st_ino != current.st_ino;
+}
+
+
+void GPIO::deliver(const Value val, const TimePoint when)
+{
+   Diagnostics* const diagnostics = _diagnostics.load(std::memory_order_relaxed);
+   const TimePoint    read        = diagnostics ? Clock::now() : TimePoint();
+
+   {
+      ReadSection section(_pollEpoch);
+      const Handlers* const h = _handlers.load();
+      if( h->sink != nullptr )
+         h->sink->onEdge(_id, val, when);
+
+      if( !h->isr )
+         return;
+
+      // Without threads, the callback function is called by processEvents() too
+      if( _mode == GPIO::Mode::NO_THREADS )
+      {
+         const TimePoint start = diagnostics ? Clock::now() : TimePoint();
+         h->isr(val);
+         if( diagnostics )
+         {
+            diagnostics->record(Diagnostics::TOTAL, start - when);
+            diagnostics->record(Diagnostics::CALLBACK, Clock::now() - start);
+         }
+         return;
+      }
+   }
+
+   Event event = { val, when, TimePoint() };
+   if( diagnostics )
+   {
+      event.queued = Clock::now();
+      diagnostics->record(Diagnostics::SINK, event.queued - read);
+   }
+
+#ifdef LOCKFREE
+   while( !_spsc_queue.push(event) )
+      ;
+#else
+   {
+      // Like the lockfree queue, a full queue holds up detection rather than losing transitions
+      std::unique_lock<std::mutex> lck(_eventMutex);
+      while( _eventCount == EVENT_CAPACITY )
+      {
+         if( _destructing )
+            return;
+         _eventCV.wait(lck);
+      }
+
+      _eventQueue[(_eventHead + _eventCount++) % EVENT_CAPACITY] = event;
+      _eventCV.notify_one();
+   }
+#endif
+}
+
+// Process interrupt events serially
+void GPIO::isrLoop()
+{
+   Realtime::prefaultStack();
+
+   Event event;
+   FaultCounter faults(_isrFaults, _countFaults);
+
+   while(1)
+   {
+#ifdef LOCKFREE
+      //!***************************************** BEWARE ****************************************!/
+      /// On the BeagleBone, this loop is effectively a spinlock. Unless there is a lot of GPIO
+      /// activity it will be EXTREMELY wasteful of CPU time!!! (It is guaranteed to waste an entire
+      /// quantum if not immediately successful at obtaining a value.) On Multicore systems this
+      /// approach should provide slightly lower latency than mutexes and condition variables at the
+      /// expense of CPU time. On the BeagleBone Black, it provides about 0.5 ms lower latency, but
+      /// nowhere near what the BeagleBone Black PRUs can provide (nanoseconds), or even what a
+      /// kernel module can provide (microseconds).
+      //!*****************************************************************************************!/
+      while( !_spsc_queue.pop(event) )
+         if( _destructing )
+            return;
+#else
+      std::unique_lock<std::mutex> lck(_eventMutex);
+      while( _eventCount == 0 )
+      {
+         if( _destructing == true )
+            return;
+
+         _eventCV.wait(lck);
+      }
+
+
+      event = _eventQueue[_eventHead];
+      _eventHead = (_eventHead + 1) % EVENT_CAPACITY;
+      if( _eventCount-- == EVENT_CAPACITY )
+         _eventCV.notify_one(); // _pollThread may be waiting for room
+      lck.unlock();
+#endif
+
+      /// *************************************************************
+      /// If this (user) function causes an exception to be thrown,
+      /// it will not be handled or ignored!!!
+      /// *************************************************************
+      {
+         // Transitions queued before diagnostics were enabled have no queue timestamp
+         Diagnostics* const diagnostics =
+            event.queued != TimePoint() ? _diagnostics.load(std::memory_order_relaxed) : nullptr;
+         const TimePoint start = diagnostics ? Clock::now() : TimePoint();
+
+         ReadSection section(_isrEpoch);
+         const Handlers* const h = _handlers.load();
+         if( h->isr )
+            h->isr(event.value);
+
+         if( diagnostics )
+         {
+            diagnostics->record(Diagnostics::HANDOFF, start - event.queued);
+            diagnostics->record(Diagnostics::TOTAL, start - event.detected);
+            diagnostics->record(Diagnostics::CALLBACK, Clock::now() - start);
+         }
+      }
+
+      faults.update();
+   }
+}
+
+
+
+GPIO::~GPIO()
+{
+   stop();
+   release();
+
+   if( !_exported )
+      return;
+
+   // attempt to unexport
+#if GPIO_EXCEPTIONS
+   try
+#endif
+   {
+      std::ofstream sysfs_unexport(_sysfsPath + "unexport", std::ofstream::app);
+      if( sysfs_unexport.is_open() )
+      {
+         sysfs_unexport << _id_str;
+         sysfs_unexport.close();
+      }
+      else // Do not throw exception in destructor! Effective C++ Item 8.
+      {
+         cerr << "Unable to unexport GPIO " + _id_str + "!" << endl;
+         cerr << "This will prevent initialization of another GPIO object for this GPIO." << endl;
+      }
+   }
+#if GPIO_EXCEPTIONS
+   catch(...)
+   {
+      cerr << "Exception caught in destructor for GPIO " << _id_str << endl;
+      cerr << boost::current_exception_diagnostic_information() << endl;
+   }
+#endif
+}
+
+
+void GPIO::stop()
+{
+   if( _destructing )
+      return;
+
+   // A lost GPIO must not be reattached while being torn down
+   ChipTable::instance().removePin(this);
+
+   // No scheduled or emergency transition may be written once the value file is closed
+   if( _direction == GPIO::Direction::OUT )
+   {
+      OutputScheduler::cancel(*this);
+      OutputVerifier::remove(*this);
+      SafeState::remove(*this);
+      if( ExpanderWriter* const writer = _writer.load() )
+         writer->cancel(*this);
+   }
+
+   // Set this flag to true in order to indicate to _isrThread that it needs to terminate
+   _destructing = true;
+#ifndef LOCKFREE
+   {
+      std::lock_guard<std::mutex> lck(_eventMutex);
+      _eventCV.notify_all();
+   }
+#endif
+
+   // Close the write end of the pipe to trigger a POLLHUP event, which will cause _pollThread to
+   // terminate
+   if( _pipeFD[1] >= 0 )
+   {
+      close(_pipeFD[1]);
+      _pipeFD[1] = -1;
+   }
+}
+
+
+void GPIO::release()
+{
+   if( _isrThread.joinable() )   _isrThread.join();
+   if( _pollThread.joinable() )  _pollThread.join();
+
+   // Do not close the file descriptor for the sysfs value file until _pollThread() has joined.
+   // This prevents reuse of this file descriptor by the kernel for other threads in this
+   // process while the descriptor is still in use in the poll() system call.
+   if( _pollFD >= 0 )     { close(_pollFD);    _pollFD    = -1; }
+   if( _pipeFD[0] >= 0 )  { close(_pipeFD[0]); _pipeFD[0] = -1; }
+   if( _epollFD >= 0 )    { close(_epollFD);   _epollFD   = -1; }
+   if( _timerFD >= 0 )    { close(_timerFD);   _timerFD   = -1; }
+   if( _valueFD >= 0 )    { close(_valueFD);   _valueFD   = -1; }
+   delete _handlers.exchange(nullptr);
+   delete _diagnostics.exchange(nullptr);
+}
+
+
+Result<void> GPIO::writeEdge(const Edge edge) const
+{
+   std::ofstream sysfs_edge(_sysfsPath + "gpio" + _id_str + "/edge", std::ofstream::app);
+   if( !sysfs_edge.is_open() )
+   {
+      return Result<void>::failure(
+         "Unable to set edge for GPIO " + _id_str + "." +
+         "Are you sure this GPIO can be configured for interrupts?");
+   }
+   if     ( edge == GPIO::Edge::NONE )    sysfs_edge << "none";
+   else if( edge == GPIO::Edge::RISING )  sysfs_edge << "rising";
+   else if( edge == GPIO::Edge::FALLING ) sysfs_edge << "falling";
+   else if( edge == GPIO::Edge::BOTH )    sysfs_edge << "both";
+   sysfs_edge.close();
+   return Result<void>();
+}
+
+
+void GPIO::replaceHandlers(Handlers* const handlers)
+{
+   const Handlers* const old = _handlers.exchange(handlers);
+
+   // Wait for a grace period: every thread which might still be using old must leave its read
+   // section. An even epoch means the thread is outside, and will see the new handlers the next
+   // time it enters.
+   for( const std::atomic<unsigned>* epoch : { &_pollEpoch, &_isrEpoch } )
+   {
+      const unsigned snapshot = epoch->load();
+      if( snapshot & 1 )
+      {
+         while( epoch->load() == snapshot )
+            std::this_thread::yield();
+      }
+   }
+
+   delete old;
+}
+
+
+void GPIO::setCallback(std::function<void(Value)> isr)
+{
+   std::lock_guard<std::mutex> lck(_configMutex);
+   if( !detects() )
+   {
+      raiseError("GPIO " + _id_str + " was not constructed to detect transitions");
+   }
+
+   const Handlers* const h = _handlers.load();
+   replaceHandlers(new Handlers(isr, h->sink, h->minPulseWidth));
+
+   if( isr && !_isrThread.joinable() && _mode == GPIO::Mode::THREADS )
+      _isrThread = std::thread(&GPIO::isrLoop, this);
+}
+
+
+void GPIO::setSink(EdgeSink* const sink)
+{
+   std::lock_guard<std::mutex> lck(_configMutex);
+   if( !detects() )
+   {
+      raiseError("GPIO " + _id_str + " was not constructed to detect transitions");
+   }
+
+   const Handlers* const h = _handlers.load();
+   replaceHandlers(new Handlers(h->isr, sink, h->minPulseWidth));
+}
+
+
+void GPIO::setMinPulseWidth(const Clock::duration width)
+{
+   std::lock_guard<std::mutex> lck(_configMutex);
+   if( !detects() )
+   {
+      raiseError("GPIO " + _id_str + " was not constructed to detect transitions");
+   }
+   if( width < Clock::duration::zero() )
+   {
+      raiseError("Minimum pulse width of GPIO " + _id_str + " must not be negative");
+   }
+
+   const Handlers* const h = _handlers.load();
+   replaceHandlers(new Handlers(h->isr, h->sink, width));
+}
+
+
+void GPIO::setEdge(const Edge edge)
+{
+   std::lock_guard<std::mutex> lck(_configMutex);
+   if( !detects() )
+   {
+      raiseError("GPIO " + _id_str + " was not constructed to detect transitions");
+   }
+
+   if( !_paused )
+      writeEdge(edge).orRaise();
+   _edge = edge;
+}
+
+
+void GPIO::pause()
+{
+   std::lock_guard<std::mutex> lck(_configMutex);
+   if( !detects() )
+   {
+      raiseError("GPIO " + _id_str + " was not constructed to detect transitions");
+   }
+   if( _paused )
+      return;
+
+   _paused = true;
+   writeEdge(GPIO::Edge::NONE).orRaise();
+}
+
+
+void GPIO::resume()
+{
+   std::lock_guard<std::mutex> lck(_configMutex);
+   if( !detects() )
+   {
+      raiseError("GPIO " + _id_str + " was not constructed to detect transitions");
+   }
+   if( !_paused )
+      return;
+
+   // Cleared first: a transition reported as soon as the edge is written must not be discarded
+   _paused = false;
+   const Result<void> r = writeEdge(_edge);
+   if( !r )
+   {
+      _paused = true;
+      raiseError(r.error());
+   }
+
+   // Transitions which occurred before the kernel was told to report them again are recovered by
+   // _pollThread comparing the current level to the last one it saw
+   if( write(_pipeFD[1], &RESYNC, 1) != 1 )
+   {
+      perror("write");
+      raiseError("Unable to resynchronize GPIO " + _id_str);
+   }
+}
+
+
+GPIO::FaultCounter::FaultCounter(std::atomic<unsigned long>& faults,
+                                 const std::atomic<bool>& enabled) :
+   _faults(faults),
+   _enabled(enabled),
+   _baseline(0),
+   _warm(false)
+{}
+
+
+void GPIO::FaultCounter::update()
+{
+   if( !_enabled )
+   {
+      _warm = false; // Counted afresh if enabled again
+      return;
+   }
+
+   // Faults while handling the first transition (first use of the handlers' code and data) are
+   // part of warming up, not of the steady state
+   if( !_warm )
+   {
+      _baseline = Realtime::minorFaults();
+      _warm     = true;
+      return;
+   }
+   _faults = Realtime::minorFaults() - _baseline;
+}
+
+
+Diagnostics& GPIO::enableDiagnostics()
+{
+   std::lock_guard<std::mutex> lck(_configMutex);
+   if( !detects() )
+   {
+      raiseError("GPIO " + _id_str + " was not constructed to detect transitions");
+   }
+
+   Diagnostics* diagnostics = _diagnostics.load();
+   if( diagnostics == nullptr )
+   {
+      diagnostics = new Diagnostics(); // deleted in release()
+      _diagnostics = diagnostics;
+   }
+   return *diagnostics;
+}
+
+
+void GPIO::markLost()
+{
+   _lost = true;
+}
+
+
+Result<void> GPIO::reattach()
+{
+   std::lock_guard<std::mutex> lck(_configMutex);
+
+   Result<void> r = configure(_shadow);
+   if( !r )
+      return r;
+
+   // Replace the value file without changing the descriptor number, which other threads (and the
+   // SafeState signal handler) may be using
+   {
+      const std::string& path(_valuePath);
+      const int fd = open(path.c_str(), valueFlags());
+      if( fd < 0 )
+      {
+         perror("open");
+         return Result<void>::failure("Unable to reopen " + path);
+      }
+      dup2(fd, _valueFD);
+      close(fd);
+   }
+
+   if( detects() )
+   {
+      r = writeEdge(_paused ? GPIO::Edge::NONE : GPIO::Edge(_edge));
+      if( !r )
+         return r;
+
+      // _pollThread (or processEvents()) reopens its value file and clears _lost itself
+      if( write(_pipeFD[1], &ATTACH, 1) != 1 )
+      {
+         perror("write");
+         return Result<void>::failure("Unable to reattach GPIO " + _id_str);
+      }
+   }
+   else
+   {
+      _lost = false;
+   }
+   return Result<void>();
+}
+
+
+Result<void> GPIO::trySetValue(const Value value) const
+{
+   if( _direction == GPIO::Direction::IN )
+   {
+      return Result<void>::failure("Cannot set value on an input GPIO");
+   }
+   if( _lost )
+   {
+      return Result<void>::failure("GPIO " + _id_str + " is lost (its gpiochip has been removed)");
+   }
+
+   _shadow = (value == GPIO::Value::HIGH) ? '1' : '0';
+
+   // Expander outputs must not stall the caller, see ExpanderWriter
+   if( ExpanderWriter* const writer = _writer.load() )
+   {
+      writer->post(*this);
+      return Result<void>();
+   }
+   return writeShadow();
+}
+
+
+Result<void> GPIO::writeShadow() const
+{
+   // Concurrent callers may write their values in any order, but each one checks the shadow after
+   // its write, so whichever write reaches the pin last is followed by a write of the final shadow.
+   char c = _shadow;
+   while( true )
+   {
+      const Result<void> r = tryWriteValue(c);
+      if( !r )
+         return r;
+
+      const char now = _shadow;
+      if( now == c )
+         return Result<void>();
+      c = now;
+   }
+}
+
+
+void GPIO::setAsync(const bool async)
+{
+   if( _direction == GPIO::Direction::IN )
+   {
+      raiseError("Cannot set value on an input GPIO");
+   }
+
+   // Looked up before taking _configMutex: find() may rescan, and a rescan reattaches GPIOs, which
+   // takes their _configMutex
+   const Result<ChipTable::Chip> chip = ChipTable::instance().find(_id);
+   if( !chip )
+      raiseError(chip.error());
+   if( chip.value().slow )
+      return; // Always written by a writer thread
+
+   std::lock_guard<std::mutex> lck(_configMutex);
+
+   if( async )
+   {
+      _writer = &ExpanderWriter::forChip(chip.value().name);
+   }
+   else if( ExpanderWriter* const writer = _writer.exchange(nullptr) )
+   {
+      writer->cancel(*this);
+
+      // A value set by a thread which saw the writer but posted after the exchange (see
+      // ExpanderWriter::post()) is not written by it, so the latest shadow value is written here
+      if( !_lost )
+         writeShadow().orRaise();
+   }
+}
+
+
+void GPIO::setValues(std::initializer_list<Assignment> values)
+{
+   setValues(values.begin(), values.size());
+}
+
+
+void GPIO::setValues(const Assignment* const values, const std::size_t count)
+{
+   trySetValues(values, count).orRaise();
+}
+
+
+Result<void> GPIO::trySetValues(const Assignment* const values, const std::size_t count,
+                                 std::size_t* const failed)
+{
+   if( failed != nullptr )
+      *failed = count; // Until written
+
+   for( std::size_t i = 0; i < count; ++i )
+   {
+      const GPIO& gpio = *values[i].gpio;
+      if( gpio._direction == GPIO::Direction::IN )
+      {
+         return Result<void>::failure("Cannot set value on an input GPIO");
+      }
+      if( gpio._lost )
+      {
+         return Result<void>::failure(
+            "GPIO " + gpio._id_str + " is lost (its gpiochip has been removed)");
+      }
+   }
+
+   if( failed != nullptr )
+      *failed = 0;
+
+   // Writer threads write the shadow values, so every one must be set before any is posted
+   for( std::size_t i = 0; i < count; ++i )
+      values[i].gpio->_shadow = (values[i].value == GPIO::Value::HIGH) ? '1' : '0';
+
+   // A failed write does not stop the others; the first failure is returned
+   Result<void> result;
+   for( std::size_t i = 0; i < count; ++i )
+   {
+      const GPIO& gpio = *values[i].gpio;
+      ExpanderWriter* const writer = gpio._writer.load();
+      if( writer == nullptr )
+      {
+         const Result<void> r = gpio.writeShadow();
+         if( !r )
+         {
+            if( result )
+               result = r;
+            if( failed != nullptr )
+               ++*failed;
+         }
+         continue;
+      }
+
+      // Each expander is given all of its assignments at once, when its first one is reached
+      bool first = true;
+      for( std::size_t j = 0; j < i && first; ++j )
+         first = (values[j].gpio->_writer.load() != writer);
+
+      if( first )
+         writer->post(values + i, values + count);
+   }
+
+   return result;
+}
+
+
+void GPIO::setShadowReads(const bool shadow)
+{
+   if( _direction == GPIO::Direction::IN )
+   {
+      raiseError("Cannot read the shadow value of an input GPIO");
+   }
+   _shadowReads = shadow;
+}
+
+
+int GPIO::valueFlags() const
+{
+   return _direction == GPIO::Direction::OUT ? O_RDWR : O_RDONLY;
+}
+
+
+Result<void> GPIO::tryWriteValue(const char c) const
+{
+   // sysfs attributes are rewritten in full by every write at offset 0
+   if( pwrite(_valueFD, &c, 1, 0) != 1 )
+   {
+      // The chip went away, perhaps returning before the monitor noticed. The GPIO is lost until a
+      // rescan reattaches it, which is requested here in case the chip is already back.
+      if( chipRemoved() || valueFileReplaced() )
+      {
+         _lost = true;
+         ChipTable::instance().requestRescan();
+         return Result<void>::failure(
+            "GPIO " + _id_str + " is lost (its gpiochip has been removed)");
+      }
+
+      perror("pwrite");
+      return Result<void>::failure("Unable to set value for GPIO " + _id_str);
+   }
+   return Result<void>();
+}
+
+
+void GPIO::setValueAt(const Value value, const TimePoint when) const
+{
+   if( _direction == GPIO::Direction::IN )
+   {
+      raiseError("Cannot set value on an input GPIO");
+   }
+
+   OutputScheduler::instance().schedule(*this, value, when);
+}
+
+
+Result<GPIO::Value> GPIO::tryGetValue() const
+{
+   if( _shadowReads )
+      return (_shadow == '1') ? GPIO::Value::HIGH : GPIO::Value::LOW;
+
+   char value;
+   if( pread(_valueFD, &value, 1, 0) != 1 )
+   {
+      perror("pread");
+      return Result<Value>::failure("Unable to get value for GPIO " + _id_str);
+   }
 
-   return(val);
+   if     ( value == '0' )  return GPIO::Value::LOW;
+   else if( value == '1' )  return GPIO::Value::HIGH;
+   return Result<Value>::failure("Invalid value read from GPIO " + _id_str + ": " + value);
 }
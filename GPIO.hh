@@ -25,13 +25,25 @@ SOFTWARE.
 #ifndef GPIO_HH
 #define GPIO_HH
 
+#include "Result.hh"
 #include "Uncopyable.hh"
 
 #include <atomic>
+#include <chrono>
+#include <cstddef>
 #include <functional>
+#include <initializer_list>
+#include <memory>
+#include <mutex>
 #include <string>
 #include <thread>
 
+#include <unistd.h>
+
+struct pollfd;
+class Diagnostics;
+class ExpanderWriter;
+
 // LOCKFREE define specifies the use of a (single producer, single consumer) lockfree container for
 // the transfer of transition events from the thread which detects these events, to the thread which
 // will call the user-provided callback function. This implementation is EXTREMELY wasteful of CPU
@@ -40,14 +52,20 @@ SOFTWARE.
 #ifdef LOCKFREE
    #include <boost/lockfree/spsc_queue.hpp>
 #else
-   #include <queue>
-   #include <mutex>
    #include <condition_variable>
 #endif
 
 
 class GPIO : private Uncopyable
 {
+   friend class Affinity;
+   friend class ChipTable;
+   friend class ExpanderWriter;
+   friend class GPIOTest; // test/alloc.cc
+   friend class OutputVerifier;
+   friend class PinGroup;
+   friend class SafeState;
+
 public:
 
    //-----------------------------------------------------------------------------------------------
@@ -80,6 +98,52 @@ public:
       BOTH
    };
 
+   //-----------------------------------------------------------------------------------------------
+   /// @enum Mode
+   /// @brief Type used to indicate how transitions on an input GPIO are detected. With THREADS, a
+   ///        thread waits for them (and another calls the callback function). With NO_THREADS, no
+   ///        thread is created: the program waits for fd() to become readable in its own event
+   ///        loop, and calls processEvents().
+   //-----------------------------------------------------------------------------------------------
+   enum class Mode : char {
+      THREADS,
+      NO_THREADS
+   };
+
+   //-----------------------------------------------------------------------------------------------
+   /// @brief Clock used to timestamp transitions as soon as they are detected.
+   //-----------------------------------------------------------------------------------------------
+   typedef std::chrono::steady_clock Clock;
+   typedef Clock::time_point         TimePoint;
+
+   //-----------------------------------------------------------------------------------------------
+   /// @class EdgeSink
+   /// @brief Interface for consumers of timestamped transitions. An EdgeSink is called directly
+   ///        from the thread which detects transitions, before (and without) the hand-off to the
+   ///        thread which calls the user-provided callback function, so its functions must be
+   ///        short and must not block.
+   //-----------------------------------------------------------------------------------------------
+   class EdgeSink
+   {
+   public:
+      virtual ~EdgeSink() = default;
+
+      /// Called once, before any call to onEdge(), with the level of the GPIO when detection began.
+      /// Called from the thread constructing the GPIO, before its detection thread starts.
+      virtual void onInitial(unsigned short /*id*/, Value /*value*/, TimePoint /*when*/) {}
+
+      /// Called for every transition of the configured edge type. when is the time at which the
+      /// detection thread was woken by the transition.
+      virtual void onEdge(unsigned short id, Value value, TimePoint when) = 0;
+
+      /// Longest time the detection thread may block waiting for a transition before calling
+      /// onIdle(). Queried before every wait. Clock::duration::max() means wait indefinitely.
+      virtual Clock::duration idleTimeout() const { return Clock::duration::max(); }
+
+      /// Called when idleTimeout() elapsed without a transition.
+      virtual void onIdle(unsigned short /*id*/, TimePoint /*now*/) {}
+   };
+
 
    //-----------------------------------------------------------------------------------------------
    // FUNCTION NAME: GPIO (constructor)
@@ -105,6 +169,8 @@ public:
    /// @param[in]   id    The GPIO ID. Often referred to as "pin number".
    /// @param[in]   edge  The type (INPUT or OUTPUT) of GPIO to construct.
    /// @param[in]   isr   The function to call when transitions of type edge occur.
+   /// @param[in]   mode  Whether to detect transitions in threads of this object, or in
+   ///                    processEvents().
    ///
    /// @note If function isr throws an exception, IT WILL NOT BE HANDLED OR IGNORED BY THIS CLASS.
    ///       Therefore, it is recommended to make this function noexcept.
@@ -113,7 +179,33 @@ public:
    explicit GPIO(
       unsigned short id,
       Edge edge,
-      std::function<void(Value)> isr);
+      std::function<void(Value)> isr,
+      Mode mode = Mode::THREADS);
+
+
+   //-----------------------------------------------------------------------------------------------
+   // FUNCTION NAME: GPIO (constructor)
+   ///
+   /// @brief Construt an input GPIO object which will pass every transition of type edge, with its
+   ///        timestamp, to sink from the thread which detects it. If isr is provided, it will also
+   ///        be called for every transition, exactly as with the constructor above.
+   ///
+   /// @param[in]   id    The GPIO ID. Often referred to as "pin number".
+   /// @param[in]   edge  The type of transitions which should be reported.
+   /// @param[in]   sink  The consumer of timestamped transitions. Must outlive this object.
+   /// @param[in]   isr   Optional function to call when transitions of type edge occur.
+   /// @param[in]   mode  Whether to detect transitions in threads of this object, or in
+   ///                    processEvents().
+   ///
+   /// @note No thread is created for the user-provided callback function if isr is empty.
+   ///
+   //-----------------------------------------------------------------------------------------------
+   explicit GPIO(
+      unsigned short id,
+      Edge edge,
+      EdgeSink& sink,
+      std::function<void(Value)> isr = std::function<void(Value)>(),
+      Mode mode = Mode::THREADS);
 
 
    //-----------------------------------------------------------------------------------------------
@@ -126,6 +218,34 @@ public:
    ~GPIO();
 
 
+   //-----------------------------------------------------------------------------------------------
+   // FUNCTION NAME: create
+   ///
+   /// @brief Construct a GPIO object exactly as the constructor with the same parameters does, but
+   ///        report failure as an error rather than an exception. Usable when exceptions are
+   ///        disabled (see Result.hh).
+   ///
+   /// @return The GPIO object, or the reason it could not be constructed.
+   ///
+   //-----------------------------------------------------------------------------------------------
+   static Result<std::unique_ptr<GPIO>> create(
+      unsigned short id,
+      Direction direction);
+
+   static Result<std::unique_ptr<GPIO>> create(
+      unsigned short id,
+      Edge edge,
+      std::function<void(Value)> isr,
+      Mode mode = Mode::THREADS);
+
+   static Result<std::unique_ptr<GPIO>> create(
+      unsigned short id,
+      Edge edge,
+      EdgeSink& sink,
+      std::function<void(Value)> isr = std::function<void(Value)>(),
+      Mode mode = Mode::THREADS);
+
+
    //-----------------------------------------------------------------------------------------------
    // FUNCTION NAME: setValue
    ///
@@ -135,8 +255,97 @@ public:
    ///
    /// @return None
    ///
+   /// @note GPIOs of I/O expanders (gpiochips on I2C, SPI or USB) are written asynchronously by an
+   ///       ExpanderWriter, so this function returns before the value has reached the pin, and
+   ///       write errors are reported on stderr rather than thrown.
+   ///
+   /// @note Thread-safe. Concurrent calls are resolved last-writer-wins: once they have all
+   ///       returned, the pin holds the value of whichever call set the shadow value last, even if
+   ///       the kernel received their writes in a different order.
+   ///
+   /// @note Defined inline (below), so that the common case is a single pwrite() in the caller.
+   ///       Allocates no memory, except to build the error when it fails.
+   ///
+   //-----------------------------------------------------------------------------------------------
+   inline void setValue(const Value value) const;
+
+   /// As setValue(), but errors are returned rather than thrown.
+   Result<void> trySetValue(const Value value) const;
+
+
+   //-----------------------------------------------------------------------------------------------
+   /// @struct Assignment
+   /// @brief A value for an output, for setValues()
+   //-----------------------------------------------------------------------------------------------
+   struct Assignment
+   {
+      const GPIO* gpio;
+      Value       value;
+   };
+
+
+   //-----------------------------------------------------------------------------------------------
+   // FUNCTION NAME: setValues
+   ///
+   /// @brief Set the values of several outputs at once. Assignments to outputs of the same I/O
+   ///        expander are handed to its ExpanderWriter together, so they are written in a single
+   ///        pass, and later assignments to an output replace earlier ones. Other outputs are
+   ///        written in order, as by setValue().
+   ///
+   /// @param[in]   values   The outputs and their values.
+   ///
+   /// @return None
+   ///
+   /// @note Every GPIO is checked before any is written, so nothing is written if any is an input
+   ///       or lost.
+   ///
+   /// @note Each output is still written separately (one bus transaction per output of an I/O
+   ///       expander), since sysfs has no multi-line write. What is saved is the per-output hand-off
+   ///       to the writer thread, and the writes of values superseded before they were written.
+   ///       bench/setvalues measures both.
+   ///
+   //-----------------------------------------------------------------------------------------------
+   static void setValues(std::initializer_list<Assignment> values);
+   static void setValues(const Assignment* values, std::size_t count);
+
+   /// As setValues(), but errors are returned rather than thrown. A failed write does not stop the
+   /// remaining ones, and the first failure is returned. If failed is given, it receives the number
+   /// of assignments not carried out (all of them if any GPIO is an input or lost). Assignments
+   /// handed to a writer thread count as carried out.
+   static Result<void> trySetValues(const Assignment* values, std::size_t count,
+                                    std::size_t* failed = nullptr);
+
+
+   //-----------------------------------------------------------------------------------------------
+   // FUNCTION NAME: setValueAt
+   ///
+   /// @brief Set the logical value (HIGH or LOW) of the GPIO at an absolute time. The transition is
+   ///        executed by the process-wide OutputScheduler. Pending transitions are discarded when
+   ///        this object is destroyed.
+   ///
+   /// @param[in]   value    The logical value to set.
+   /// @param[in]   when     The time at which to set it. Times in the past are executed at once.
+   ///
+   /// @return None
+   ///
+   //-----------------------------------------------------------------------------------------------
+   void setValueAt(const Value value, const TimePoint when) const;
+
+
+   //-----------------------------------------------------------------------------------------------
+   // FUNCTION NAME: setAsync
+   ///
+   /// @brief Choose whether setValue() writes this output itself, or hands the value to the writer
+   ///        thread of its gpiochip (see ExpanderWriter) through a lock-free queue and returns.
+   ///        Handing off suits many producer threads: the caller never makes a system call, and
+   ///        values set faster than they can be written are coalesced. Outputs of I/O expanders
+   ///        are always written by their writer thread.
+   ///
+   /// @note May be called while other threads set values of this output. A value set meanwhile is
+   ///       written either directly or by the writer thread, and the last one set is left on the pin.
+   ///
    //-----------------------------------------------------------------------------------------------
-   void setValue(const Value value) const;
+   void setAsync(bool async);
 
 
    //-----------------------------------------------------------------------------------------------
@@ -146,24 +355,297 @@ public:
    ///
    /// @return The logical value of the GPIO.
    ///
+   /// @note Defined inline (below), so that the common case is a single pread() in the caller,
+   ///       or no system call at all for an output reading its shadow value (see
+   ///       setShadowReads()). Allocates no memory, except to build the error when it fails.
+   ///
+   //-----------------------------------------------------------------------------------------------
+   inline Value getValue() const;
+
+   /// As getValue(), but errors are returned rather than thrown.
+   Result<Value> tryGetValue() const;
+
+
+   //-----------------------------------------------------------------------------------------------
+   // FUNCTION NAME: setShadowReads
+   ///
+   /// @brief Choose whether getValue() on this output returns the value last set, without reading
+   ///        the pin. Saves a system call per read, but a shorted or contended pin then goes
+   ///        unnoticed; register the output with OutputVerifier to have its level read back
+   ///        periodically instead.
+   ///
+   /// @note Only valid for outputs. The value of an output written by a writer thread (see
+   ///       setAsync()) may not have reached the pin yet.
+   ///
+   //-----------------------------------------------------------------------------------------------
+   void setShadowReads(bool shadow);
+
+
+   //-----------------------------------------------------------------------------------------------
+   // FUNCTION NAME: setCallback
+   ///
+   /// @brief Replace the function called when transitions occur, without pausing detection. An
+   ///        empty function stops callbacks. Transitions already queued are delivered to whichever
+   ///        function is installed when they are dequeued.
+   ///
+   /// @note Only valid for a GPIO constructed with an Edge. When this function returns, the
+   ///       previous function is no longer in use and no longer referenced. Must not be called
+   ///       from the callback function or the EdgeSink of this GPIO.
+   ///
+   //-----------------------------------------------------------------------------------------------
+   void setCallback(std::function<void(Value)> isr);
+
+
+   //-----------------------------------------------------------------------------------------------
+   // FUNCTION NAME: setSink
+   ///
+   /// @brief Replace the EdgeSink, without pausing detection. nullptr removes it.
+   ///
+   /// @note Only valid for a GPIO constructed with an Edge. When this function returns, the
+   ///       previous sink is no longer in use and may be destroyed. Must not be called from the
+   ///       callback function or the EdgeSink of this GPIO.
+   ///
+   //-----------------------------------------------------------------------------------------------
+   void setSink(EdgeSink* sink);
+
+
+   //-----------------------------------------------------------------------------------------------
+   // FUNCTION NAME: setMinPulseWidth
+   ///
+   /// @brief Reject pulses shorter than width. A transition is held back until the new level has
+   ///        lasted width, and is then delivered with the time at which it was detected. If the
+   ///        level changes back first, both transitions are discarded and counted (see
+   ///        glitches()). Zero, the default, delivers every transition as soon as it is detected.
+   ///
+   /// @note Only valid for a GPIO constructed with an Edge. Every transition which passes is
+   ///       delivered width late. The level is read again when width has elapsed, so a pulse whose
+   ///       trailing edge is not reported (e.g. with Edge::RISING) is rejected too. In
+   ///       Mode::NO_THREADS, fd() becomes readable when a held transition is due.
+   ///
+   //-----------------------------------------------------------------------------------------------
+   void setMinPulseWidth(Clock::duration width);
+
+
+   /// Number of pulses rejected for being shorter than the minimum pulse width.
+   unsigned long glitches() const { return _glitches; }
+
+
+   //-----------------------------------------------------------------------------------------------
+   // FUNCTION NAME: setEdge
+   ///
+   /// @brief Change which transitions the kernel reports, without pausing detection.
+   ///
+   /// @note Only valid for a GPIO constructed with an Edge.
+   ///
+   //-----------------------------------------------------------------------------------------------
+   void setEdge(Edge edge);
+
+
+   //-----------------------------------------------------------------------------------------------
+   // FUNCTION NAME: pause
+   ///
+   /// @brief Stop reporting transitions, without tearing down this object. The kernel is told to
+   ///        stop detecting transitions, so a paused GPIO costs nothing.
+   ///
+   /// @note Only valid for a GPIO constructed with an Edge.
+   ///
+   //-----------------------------------------------------------------------------------------------
+   void pause();
+
+
+   //-----------------------------------------------------------------------------------------------
+   // FUNCTION NAME: resume
+   ///
+   /// @brief Resume reporting transitions. If the level changed while paused, and the change is one
+   ///        of the transitions this GPIO reports, it is reported once, timestamped at resumption.
+   ///
+   /// @note Only valid for a GPIO constructed with an Edge.
+   ///
+   //-----------------------------------------------------------------------------------------------
+   void resume();
+
+
+   //-----------------------------------------------------------------------------------------------
+   // FUNCTION NAME: fd
+   ///
+   /// @brief A file descriptor which is readable (POLLIN/EPOLLIN) whenever processEvents() has work
+   ///        to do: a transition, or a request made through resume() or by ChipTable. It may be
+   ///        watched level-triggered by poll(), epoll or any event loop library.
+   ///
+   /// @note Only valid for a GPIO constructed with Mode::NO_THREADS; -1 otherwise.
+   ///
+   //-----------------------------------------------------------------------------------------------
+   int fd() const { return _epollFD; }
+
+
+   //-----------------------------------------------------------------------------------------------
+   // FUNCTION NAME: processEvents
+   ///
+   /// @brief Handle whatever made fd() readable, without blocking. The EdgeSink and callback
+   ///        function are called from the calling thread, before this function returns. May be
+   ///        called spuriously.
+   ///
+   /// @note Only valid for a GPIO constructed with Mode::NO_THREADS. Must not be called from more
+   ///       than one thread at a time. EdgeSink::idleTimeout() is not used in this mode, since the
+   ///       program's event loop owns the timeout.
+   ///
+   //-----------------------------------------------------------------------------------------------
+   void processEvents();
+
+
+   //-----------------------------------------------------------------------------------------------
+   // FUNCTION NAME: enableDiagnostics
+   ///
+   /// @brief Start measuring the latency of every stage between detection of a transition and the
+   ///        call of the callback function (see Diagnostics). Idempotent. Until enabled, the cost is
+   ///        one atomic load per transition.
+   ///
+   /// @return The histograms, which remain valid for the lifetime of this object.
+   ///
+   /// @note Only valid for a GPIO constructed with an Edge.
+   ///
    //-----------------------------------------------------------------------------------------------
-   Value getValue() const;
+   Diagnostics& enableDiagnostics();
+
+
+   //-----------------------------------------------------------------------------------------------
+   // FUNCTION NAME: countPageFaults
+   ///
+   /// @brief Start or stop counting the minor page faults which the threads of this GPIO take while
+   ///        handling transitions (see pageFaults()). Meant for commissioning, together with
+   ///        Realtime::init(): counting costs a getrusage() call per transition in each thread, so
+   ///        it is off by default.
+   ///
+   //-----------------------------------------------------------------------------------------------
+   void countPageFaults(bool count) { _countFaults = count; }
+
+
+   /// Minor page faults taken by the threads of this GPIO while handling transitions, from the
+   /// second transition after countPageFaults(true). Zero in steady state unless something on the
+   /// path touches memory which is not resident.
+   unsigned long pageFaults() const { return _pollFaults + _isrFaults; }
+
+
+   /// The GPIO ID with which this object was constructed.
+   unsigned short id() const { return _id; }
+
+   /// The direction with which this object was constructed.
+   Direction direction() const { return _direction; }
+
+   /// Whether the gpiochip providing this GPIO has been removed. A lost GPIO reports no transitions
+   /// and cannot be set. It recovers automatically if ChipTable::startMonitor() has been called
+   /// and the chip returns.
+   bool lost() const { return _lost; }
 
 
 private:
-   void initCommon() const;
+   //-----------------------------------------------------------------------------------------------
+   /// @struct Handlers
+   /// @brief The consumers of transitions. Never modified once published: it is replaced as a
+   ///        whole (read-copy-update), so the threads which use it never take a lock.
+   //-----------------------------------------------------------------------------------------------
+   struct Handlers
+   {
+      Handlers() : isr(), sink(nullptr), minPulseWidth(Clock::duration::zero()) {}
+      Handlers(std::function<void(Value)> i, EdgeSink* s,
+               Clock::duration w = Clock::duration::zero()) : isr(i), sink(s), minPulseWidth(w) {}
+
+      const std::function<void(Value)> isr;
+      EdgeSink* const                  sink;
+      const Clock::duration            minPulseWidth; // see setMinPulseWidth()
+   };
+
+   //-----------------------------------------------------------------------------------------------
+   /// @class ReadSection
+   /// @brief Marks the calling thread as possibly using the current Handlers for its lifetime. The
+   ///        epoch is odd while inside.
+   //-----------------------------------------------------------------------------------------------
+   class ReadSection
+   {
+   public:
+      explicit ReadSection(std::atomic<unsigned>& epoch) : _epoch(epoch) { ++_epoch; }
+      ~ReadSection() { ++_epoch; }
+   private:
+      std::atomic<unsigned>& _epoch;
+   };
+
+   GPIO(unsigned short id, Direction direction, Edge edge, Handlers* handlers, Mode mode);
+
+   Result<void> init(bool detect);
+   Result<void> initCommon();
+   Result<void> configure(char value) const;
+   Result<void> initEdge();
+   Result<void> readInitial();
+   void initPollSet(struct pollfd* fdset) const;
+   bool handleEvents(struct pollfd* fdset, TimePoint now); // false once asked to terminate
+   void watch(bool watching); // add _pollFD to, or remove it from, _epollFD
+   bool detects() const { return _pipeFD[0] >= 0; } // constructed with an Edge
+   Result<void> writeEdge(Edge edge) const;
+   void replaceHandlers(Handlers* handlers);
+   //-----------------------------------------------------------------------------------------------
+   /// @struct Event
+   /// @brief A transition on its way to the callback thread
+   //-----------------------------------------------------------------------------------------------
+   struct Event
+   {
+      Value     value;
+      TimePoint detected; // poll() returned
+      TimePoint queued;   // only set while diagnostics are enabled
+   };
+
+   //-----------------------------------------------------------------------------------------------
+   /// @class FaultCounter
+   /// @brief Publishes the page faults taken by the calling thread since it warmed up
+   //-----------------------------------------------------------------------------------------------
+   class FaultCounter
+   {
+   public:
+      FaultCounter(std::atomic<unsigned long>& faults, const std::atomic<bool>& enabled);
+      void update(); // after each transition handled
+   private:
+      std::atomic<unsigned long>& _faults;
+      const std::atomic<bool>&    _enabled;
+      unsigned long               _baseline;
+      bool                        _warm;
+   };
+
+   void filterPulse(Value val, TimePoint when);
+   void releaseHeld(struct pollfd& fdset);
+   void armTimer(Clock::duration timeout) const;
+
+   bool readValue(char* buf, int len, Value& val) const;
+   bool chipRemoved() const;
+   bool valueFileReplaced() const; // _valueFD is not the current value file; called by ChipTable
+   void goLost(struct pollfd& fdset);
+   void deliver(Value val, TimePoint when);
+   Result<void> tryWriteValue(char c) const;
+   Result<void> writeShadow() const; // write _shadow until the pin is left at its final value
+   int valueFlags() const; // open() flags of _valueFD
+   void markLost(); // called by ChipTable
+   Result<void> reattach(); // called by ChipTable
+   void stop();    // ask the threads to terminate, without waiting
+   void release(); // wait for the threads to terminate and close all file descriptors
    void pollLoop();
    void isrLoop();
 
 private:
    static const std::string  _sysfsPath;
+   static const char         RESYNC = 'r'; // _pollThread command: report a level change missed while paused
+   static const char         ATTACH = 'a'; // _pollThread command: the gpiochip has returned
+   static const std::size_t  EVENT_CAPACITY = 64; // transitions queued for _isrThread
 
    const unsigned short _id;
    const std::string    _id_str;
+   const std::string    _valuePath; // built once, so that reopening it on reattach allocates nothing
    const Direction      _direction;
+   const Mode           _mode;
+
+   std::atomic<Edge> _edge;
 
-   const Edge _edge;
-   const std::function<void(Value)> _isr;
+   std::atomic<Handlers*> _handlers;  // replaced by replaceHandlers() only
+   std::atomic<unsigned>  _pollEpoch; // read section epoch of _pollThread
+   std::atomic<unsigned>  _isrEpoch;  // read section epoch of _isrThread
+   std::mutex             _configMutex; // serializes configuration changes, never taken by threads
 
    std::thread _pollThread;
    int _pollFD;
@@ -171,16 +653,81 @@ private:
    std::thread _isrThread;
 
    std::atomic<bool> _destructing;
-   int               _pipeFD[2];
+   int               _pipeFD[2];   // commands to _pollThread, see initEdge()
+   int               _epollFD;     // watches _pollFD and _pipeFD[0] in Mode::NO_THREADS
+   std::atomic<bool> _paused;
+   Value             _last;        // last value read by _pollThread (or processEvents())
+   int               _timerFD;     // due time of _heldAt in Mode::NO_THREADS, watched by _epollFD
+
+   // A transition waiting to have lasted the minimum pulse width, see filterPulse()
+   bool              _held;
+   Value             _heldValue;
+   TimePoint         _heldAt;
+   std::atomic<unsigned long> _glitches; // pulses rejected by filterPulse()
+
+   std::atomic<Diagnostics*> _diagnostics; // nullptr until enableDiagnostics()
+
+   std::atomic<bool>          _countFaults; // see countPageFaults()
+   std::atomic<unsigned long> _pollFaults;  // steady state page faults of _pollThread
+   std::atomic<unsigned long> _isrFaults;   // steady state page faults of _isrThread
+
+   int _valueFD; // value file, open for the lifetime of the object (read-write for outputs)
+
+   mutable std::atomic<char> _shadow; // last value requested of an output, restored on reattach
+   std::atomic<bool>         _shadowReads; // getValue() returns _shadow, see setShadowReads()
+
+   std::atomic<ExpanderWriter*> _writer; // writes outputs for setValue(), or nullptr, see setAsync()
+
+   mutable std::atomic<bool> _dirty;     // queued in _writer, see ExpanderWriter
+   mutable const GPIO*       _nextDirty; // next in the queue of _writer, valid only while _dirty
+
+   bool _exported; // cleared once unexported, possibly by a PinGroup on this object's behalf
+
+   mutable std::atomic<bool> _lost; // the gpiochip providing this GPIO has been removed
 
 #ifdef LOCKFREE
-   boost::lockfree::spsc_queue<Value, boost::lockfree::capacity<64>> _spsc_queue;
+   boost::lockfree::spsc_queue<Event, boost::lockfree::capacity<EVENT_CAPACITY>> _spsc_queue;
 #else
-   std::queue<Value>        _eventQueue; // stores values generated by interrupts
+   Event                    _eventQueue[EVENT_CAPACITY]; // ring of transitions for _isrThread
+   std::size_t              _eventHead;  // oldest
+   std::size_t              _eventCount;
    std::mutex               _eventMutex;
-   std::condition_variable  _eventCV;
+   std::condition_variable  _eventCV;    // signalled when the ring becomes non-empty or non-full
 #endif
 
 };
 
+
+
+// The error paths, and outputs which are not written directly, are handled out of line by the
+// try variants, which also produce the error messages.
+inline void GPIO::setValue(const Value value) const
+{
+   const char c = (value == GPIO::Value::HIGH) ? '1' : '0';
+   if( _direction == GPIO::Direction::OUT && _writer.load() == nullptr && !_lost )
+   {
+      _shadow = c;
+      if( pwrite(_valueFD, &c, 1, 0) == 1 && _shadow == c )
+         return;
+
+      writeShadow().orRaise(); // Another thread set a value meanwhile, or the write failed
+      return;
+   }
+
+   trySetValue(value).orRaise();
+}
+
+
+inline GPIO::Value GPIO::getValue() const
+{
+   if( _shadowReads )
+      return (_shadow == '1') ? GPIO::Value::HIGH : GPIO::Value::LOW;
+
+   char c;
+   if( pread(_valueFD, &c, 1, 0) == 1 && (c == '0' || c == '1') )
+      return (c == '1') ? GPIO::Value::HIGH : GPIO::Value::LOW;
+
+   return tryGetValue().orRaise();
+}
+
 #endif
@@ -0,0 +1,191 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2014 Thomas Mercier Jr.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "LogicAnalyzer.hh"
+#include "Result.hh"
+
+#include <algorithm>
+#include <functional>
+#include <queue>
+#include <string>
+#include <tuple>
+
+
+
+const std::size_t LogicAnalyzer::MAX_PROBES;
+
+
+LogicAnalyzer::Probe::Probe(unsigned short id, std::size_t depth) :
+   _id(id),
+   _ring(depth),
+   _overruns(0),
+   _initial(-1),
+   _level(-1)
+{
+   _drained.reserve(depth);
+}
+
+
+void LogicAnalyzer::Probe::onInitial(unsigned short, GPIO::Value value, GPIO::TimePoint)
+{
+   _initial = static_cast<int>(value);
+}
+
+
+void LogicAnalyzer::Probe::onEdge(unsigned short, GPIO::Value value, GPIO::TimePoint when)
+{
+   const Sample sample = { when, value };
+   if( !_ring.push(sample) )
+      ++_overruns;
+}
+
+
+
+LogicAnalyzer::LogicAnalyzer(std::size_t depth) :
+   _depth(depth),
+   _origin(GPIO::Clock::now())
+{
+   if( _depth == 0 )
+   {
+      raiseError("LogicAnalyzer depth must be non-zero");
+   }
+}
+
+
+GPIO::EdgeSink& LogicAnalyzer::probe(unsigned short id)
+{
+   if( _probes.size() == MAX_PROBES )
+   {
+      raiseError(
+         "LogicAnalyzer supports at most " + std::to_string(MAX_PROBES) + " probes");
+   }
+
+   for( const auto& p : _probes )
+   {
+      if( p->_id == id )
+      {
+         raiseError("LogicAnalyzer already has a probe for GPIO " + std::to_string(id));
+      }
+   }
+
+   _probes.emplace_back(new Probe(id, _depth));
+   return *_probes.back();
+}
+
+
+unsigned long LogicAnalyzer::overruns() const
+{
+   unsigned long total = 0;
+   for( const auto& p : _probes )
+      total += p->_overruns;
+   return total;
+}
+
+
+namespace
+{
+   // VCD identifiers are strings of printable characters; one character suffices for 32 probes
+   char vcdCode(std::size_t index) { return static_cast<char>('!' + index); }
+
+   char vcdLevel(int value)
+   {
+      if     ( value == static_cast<int>(GPIO::Value::HIGH) ) return '1';
+      else if( value == static_cast<int>(GPIO::Value::LOW) )  return '0';
+      return 'x';
+   }
+}
+
+
+void LogicAnalyzer::writeVcd(std::ostream& os)
+{
+   // Drain every ring first, so that the merge below sees a consistent snapshot. Each ring has a
+   // single producer, so its contents are already in time order.
+   for( auto& p : _probes )
+   {
+      p->_drained.clear();
+      Sample sample;
+      while( p->_ring.pop(sample) )
+         p->_drained.push_back(sample);
+
+      if( p->_level < 0 )
+         p->_level = p->_initial;
+   }
+
+
+   os << "$timescale 1ns $end\n";
+   os << "$scope module gpio $end\n";
+   for( std::size_t i = 0; i < _probes.size(); ++i )
+   {
+      os << "$var wire 1 " << vcdCode(i) << " gpio" << _probes[i]->_id << " $end\n";
+   }
+   os << "$upscope $end\n";
+   os << "$enddefinitions $end\n";
+
+   os << "$dumpvars\n";
+   for( std::size_t i = 0; i < _probes.size(); ++i )
+   {
+      os << vcdLevel(_probes[i]->_level) << vcdCode(i) << '\n';
+   }
+   os << "$end\n";
+
+
+   // k-way merge: the heap holds the next unwritten sample of every probe which has one left
+   typedef std::tuple<GPIO::TimePoint, std::size_t, std::size_t> Head; // (timestamp, probe, sample)
+   std::priority_queue<Head, std::vector<Head>, std::greater<Head>> heads;
+
+   for( std::size_t i = 0; i < _probes.size(); ++i )
+   {
+      if( !_probes[i]->_drained.empty() )
+         heads.push(Head(_probes[i]->_drained[0].when, i, 0));
+   }
+
+   bool first = true;
+   GPIO::TimePoint last;
+   while( !heads.empty() )
+   {
+      const std::size_t i = std::get<1>(heads.top());
+      const std::size_t n = std::get<2>(heads.top());
+      heads.pop();
+
+      Probe& p = *_probes[i];
+      const Sample& sample = p._drained[n];
+
+      if( first || sample.when != last )
+      {
+         using std::chrono::duration_cast;
+         using std::chrono::nanoseconds;
+         const auto t = std::max(sample.when, _origin) - _origin;
+         os << '#' << duration_cast<nanoseconds>(t).count() << '\n';
+         last  = sample.when;
+         first = false;
+      }
+      os << vcdLevel(static_cast<int>(sample.value)) << vcdCode(i) << '\n';
+      p._level = static_cast<int>(sample.value);
+
+      if( n + 1 < p._drained.size() )
+         heads.push(Head(p._drained[n + 1].when, i, n + 1));
+   }
+
+   os.flush();
+}
@@ -0,0 +1,135 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2014 Thomas Mercier Jr.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef LOGICANALYZER_HH
+#define LOGICANALYZER_HH
+
+#include "GPIO.hh"
+#include "Uncopyable.hh"
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <ostream>
+#include <vector>
+
+#include <boost/lockfree/spsc_queue.hpp>
+
+
+//--------------------------------------------------------------------------------------------------
+/// @class LogicAnalyzer
+/// @brief Captures timestamped transitions on up to MAX_PROBES input GPIOs for later export as a
+///        single time-ordered Value Change Dump (VCD), which can be viewed with GTKWave or imported
+///        into sigrok/PulseView.
+///
+/// Each probe records into its own lockfree ring from the thread which detects its transitions, so
+/// capturing requires no callbacks and no additional threads. The per-probe rings are only merged
+/// (k-way, by timestamp) when writeVcd() is called.
+///
+/// Usage:
+/// @code
+///    LogicAnalyzer la;
+///    GPIO clk(15, GPIO::Edge::BOTH, la.probe(15));
+///    GPIO dat(14, GPIO::Edge::BOTH, la.probe(14));
+///    ...
+///    std::ofstream out("capture.vcd");
+///    la.writeVcd(out);
+/// @endcode
+//--------------------------------------------------------------------------------------------------
+class LogicAnalyzer : private Uncopyable
+{
+public:
+   static const std::size_t MAX_PROBES = 32;
+
+
+   //-----------------------------------------------------------------------------------------------
+   // FUNCTION NAME: LogicAnalyzer (constructor)
+   ///
+   /// @param[in]   depth  The number of transitions each probe can hold between exports.
+   ///
+   //-----------------------------------------------------------------------------------------------
+   explicit LogicAnalyzer(std::size_t depth = 4096);
+
+
+   //-----------------------------------------------------------------------------------------------
+   // FUNCTION NAME: probe
+   ///
+   /// @brief Create the probe for GPIO id. The returned sink must be passed to the GPIO constructor,
+   ///        which should be configured for GPIO::Edge::BOTH. Probes must all be created before any
+   ///        capture begins.
+   ///
+   /// @return The EdgeSink for GPIO id. It remains valid for the lifetime of this object.
+   ///
+   //-----------------------------------------------------------------------------------------------
+   GPIO::EdgeSink& probe(unsigned short id);
+
+
+   //-----------------------------------------------------------------------------------------------
+   // FUNCTION NAME: writeVcd
+   ///
+   /// @brief Drain every probe and write the transitions captured since the previous call, merged
+   ///        in time order, as a VCD. Timestamps are in nanoseconds since construction of this
+   ///        object. Must only be called from one thread.
+   ///
+   //-----------------------------------------------------------------------------------------------
+   void writeVcd(std::ostream& os);
+
+
+   /// Number of transitions discarded because a probe's ring was full.
+   unsigned long overruns() const;
+
+private:
+   struct Sample
+   {
+      GPIO::TimePoint when;
+      GPIO::Value     value;
+   };
+
+   class Probe : public GPIO::EdgeSink
+   {
+   public:
+      Probe(unsigned short id, std::size_t depth);
+
+      void onInitial(unsigned short id, GPIO::Value value, GPIO::TimePoint when) override;
+      void onEdge(unsigned short id, GPIO::Value value, GPIO::TimePoint when) override;
+
+      const unsigned short _id;
+
+      boost::lockfree::spsc_queue<Sample> _ring;
+      std::atomic<unsigned long>          _overruns;
+
+      std::atomic<int> _initial; // -1 until known, otherwise a GPIO::Value
+
+      // Only accessed by writeVcd()
+      int                 _level;
+      std::vector<Sample> _drained;
+   };
+
+private:
+   const std::size_t               _depth;
+   const GPIO::TimePoint           _origin;
+   std::vector<std::unique_ptr<Probe>> _probes;
+};
+
+#endif
@@ -0,0 +1,204 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2014 Thomas Mercier Jr.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "OutputScheduler.hh"
+#include "Realtime.hh"
+
+#include <algorithm>
+#include <iostream>
+
+#include <pthread.h>
+#include <sched.h>
+
+
+
+const GPIO::Clock::duration OutputScheduler::SPIN_MARGIN =
+   std::chrono::duration_cast<GPIO::Clock::duration>(std::chrono::microseconds(100));
+
+std::atomic<bool> OutputScheduler::_created(false);
+
+
+OutputScheduler& OutputScheduler::instance()
+{
+   static OutputScheduler scheduler;
+   return scheduler;
+}
+
+
+OutputScheduler::OutputScheduler() :
+   _seq(0),
+   _executing(false),
+   _stop(false),
+   _stats(),
+   _realtime(false)
+{
+   _heap.reserve(64);
+   _batch.reserve(64);
+   _assignments.reserve(64);
+
+   _thread = std::thread(&OutputScheduler::run, this);
+   _created = true;
+}
+
+
+OutputScheduler::~OutputScheduler()
+{
+   _created = false; // GPIOs which outlive the scheduler have nothing left to cancel
+   {
+      std::lock_guard<std::mutex> lck(_mutex);
+      _stop = true;
+      _cv.notify_one();
+   }
+   if( _thread.joinable() )  _thread.join();
+}
+
+
+void OutputScheduler::schedule(const GPIO& output, GPIO::Value value, GPIO::TimePoint when)
+{
+   std::lock_guard<std::mutex> lck(_mutex);
+
+   const Transition t = { when, _seq++, &output, value };
+   _heap.push_back(t);
+   std::push_heap(_heap.begin(), _heap.end(), Later());
+
+   // Only a new earliest transition changes when the thread must wake up
+   if( _heap.front().seq == t.seq )
+      _cv.notify_one();
+}
+
+
+void OutputScheduler::cancel(const GPIO& output)
+{
+   if( !_created )
+      return;
+
+   OutputScheduler& s = instance();
+   std::unique_lock<std::mutex> lck(s._mutex);
+
+   s._heap.erase(
+      std::remove_if(s._heap.begin(), s._heap.end(),
+                     [&output](const Transition& t) { return t.output == &output; }),
+      s._heap.end());
+   std::make_heap(s._heap.begin(), s._heap.end(), Later());
+
+   // The batch being written may still refer to output
+   while( s._executing )
+      s._idleCV.wait(lck);
+}
+
+
+OutputScheduler::Stats OutputScheduler::stats() const
+{
+   std::lock_guard<std::mutex> lck(_mutex);
+   return _stats;
+}
+
+
+void OutputScheduler::run()
+{
+   // Real-time priority is a best effort; without it transitions are simply later
+   {
+      struct sched_param param;
+      param.sched_priority = sched_get_priority_max(SCHED_FIFO) - 1;
+      _realtime = (pthread_setschedparam(pthread_self(), SCHED_FIFO, &param) == 0);
+   }
+   Realtime::prefaultStack();
+
+   std::unique_lock<std::mutex> lck(_mutex);
+   while( !_stop )
+   {
+      if( _heap.empty() )
+      {
+         _cv.wait(lck);
+         continue;
+      }
+
+      const GPIO::TimePoint due = _heap.front().when;
+      if( GPIO::Clock::now() < due - SPIN_MARGIN )
+      {
+         _cv.wait_until(lck, due - SPIN_MARGIN);
+         continue; // The earliest transition may have changed
+      }
+
+      // Take every transition due at this instant, keeping only the latest for each GPIO
+      _batch.clear();
+      unsigned long superseded = 0;
+      while( !_heap.empty() && _heap.front().when == due )
+      {
+         std::pop_heap(_heap.begin(), _heap.end(), Later());
+         const Transition t = _heap.back();
+         _heap.pop_back();
+
+         auto it = std::find_if(_batch.begin(), _batch.end(),
+                                [&t](const Transition& b) { return b.output == t.output; });
+         if( it != _batch.end() ) { *it = t; ++superseded; }
+         else                     { _batch.push_back(t); }
+      }
+      const bool missed = GPIO::Clock::now() > due;
+      _executing = true;
+      lck.unlock();
+
+      GPIO::TimePoint start;
+      while( (start = GPIO::Clock::now()) < due )
+         ;
+
+      // Written as one bank, so that the outputs of each I/O expander are posted to its writer
+      // together. A lost output would fail the whole bank, so it is left out.
+      _assignments.clear();
+      std::size_t failed = 0;
+      for( const auto& t : _batch )
+      {
+         if( t.output->lost() )
+         {
+            std::cerr << "Scheduled transition failed: GPIO " << t.output->id() << " is lost"
+                      << std::endl;
+            ++failed;
+            continue;
+         }
+         const GPIO::Assignment a = { t.output, t.value };
+         _assignments.push_back(a);
+      }
+
+      // Nobody to report to but the user
+      std::size_t notWritten = 0;
+      const Result<void> r =
+         GPIO::trySetValues(_assignments.data(), _assignments.size(), &notWritten);
+      if( !r )
+         std::cerr << "Scheduled transition failed: " << r.error() << std::endl;
+      failed += notWritten;
+
+      lck.lock();
+      _executing = false;
+      _idleCV.notify_all();
+
+      const GPIO::Clock::duration lateness = start - due;
+      _stats.executed      += _batch.size() - failed;
+      _stats.failed        += failed;
+      _stats.superseded    += superseded;
+      _stats.missed        += missed ? _batch.size() : 0;
+      _stats.totalLateness += lateness * (_batch.size() - failed);
+      if( failed < _batch.size() )
+         _stats.maxLateness = std::max(_stats.maxLateness, lateness);
+   }
+}
@@ -0,0 +1,141 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2014 Thomas Mercier Jr.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef OUTPUTSCHEDULER_HH
+#define OUTPUTSCHEDULER_HH
+
+#include "GPIO.hh"
+#include "Uncopyable.hh"
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+//--------------------------------------------------------------------------------------------------
+/// @class OutputScheduler
+/// @brief Executes output transitions at absolute times on behalf of GPIO::setValueAt().
+///
+/// Pending transitions for all output GPIOs are kept in a single min-heap and executed by one
+/// thread, which runs at real-time priority when the process is permitted to. The thread sleeps
+/// until SPIN_MARGIN before a transition is due, and busy-waits for the remainder. Transitions due
+/// at the same instant are executed after a single wake-up, by one call of GPIO::setValues() (so
+/// the outputs of each I/O expander are handed to its writer as one batch), and a later transition
+/// for the same GPIO at that instant supersedes an earlier one.
+//--------------------------------------------------------------------------------------------------
+class OutputScheduler : private Uncopyable
+{
+public:
+   /// Time before a transition is due at which the scheduler thread stops sleeping and spins.
+   static const GPIO::Clock::duration SPIN_MARGIN;
+
+   //-----------------------------------------------------------------------------------------------
+   /// @struct Stats
+   /// @brief Lateness of executed transitions, measured from the time each was due to the time its
+   ///        write began.
+   //-----------------------------------------------------------------------------------------------
+   struct Stats
+   {
+      unsigned long         executed;   ///< Number of transitions written
+      unsigned long         failed;     ///< Transitions not written (output lost, or write error)
+      unsigned long         superseded; ///< Transitions dropped in favour of a later one
+      unsigned long         missed;     ///< Transitions already due when the thread woke up
+      GPIO::Clock::duration maxLateness;
+      GPIO::Clock::duration totalLateness;
+   };
+
+
+   /// The process-wide scheduler. Its thread is started on first use.
+   static OutputScheduler& instance();
+
+
+   //-----------------------------------------------------------------------------------------------
+   // FUNCTION NAME: schedule
+   ///
+   /// @brief Set output to value at time when. Times in the past are executed immediately.
+   ///
+   //-----------------------------------------------------------------------------------------------
+   void schedule(const GPIO& output, GPIO::Value value, GPIO::TimePoint when);
+
+
+   //-----------------------------------------------------------------------------------------------
+   // FUNCTION NAME: cancel
+   ///
+   /// @brief Discard every pending transition for output, waiting for any which is being written.
+   ///        Does nothing if the scheduler has never been used.
+   ///
+   //-----------------------------------------------------------------------------------------------
+   static void cancel(const GPIO& output);
+
+
+   /// A snapshot of the lateness statistics.
+   Stats stats() const;
+
+   /// Whether the scheduler thread obtained real-time priority.
+   bool realtime() const { return _realtime; }
+
+private:
+   OutputScheduler();
+   ~OutputScheduler();
+
+   void run();
+
+   struct Transition
+   {
+      GPIO::TimePoint when;
+      unsigned long   seq;
+      const GPIO*     output;
+      GPIO::Value     value;
+   };
+
+   // std::push_heap() builds a max-heap, so order by "later than" to keep the earliest on top
+   struct Later
+   {
+      bool operator()(const Transition& a, const Transition& b) const
+      { return a.when != b.when ? a.when > b.when : a.seq > b.seq; }
+   };
+
+private:
+   static std::atomic<bool> _created;
+
+   mutable std::mutex      _mutex;
+   std::condition_variable _cv;     // signalled when the heap or _stop change
+   std::condition_variable _idleCV; // signalled when a batch has been written
+
+   std::vector<Transition> _heap;
+   std::vector<Transition> _batch;
+   std::vector<GPIO::Assignment> _assignments; // of _batch, used by the thread only
+   unsigned long           _seq;
+   bool                    _executing;
+   bool                    _stop;
+
+   Stats             _stats;
+   std::atomic<bool> _realtime;
+
+   std::thread _thread;
+};
+
+#endif
@@ -0,0 +1,230 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2014 Thomas Mercier Jr.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "OutputVerifier.hh"
+
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+#include <string>
+
+#include <unistd.h>
+
+
+
+const GPIO::Clock::duration OutputVerifier::DEFAULT_PERIOD =
+   std::chrono::duration_cast<GPIO::Clock::duration>(std::chrono::milliseconds(100));
+
+std::atomic<bool> OutputVerifier::_created(false);
+
+
+OutputVerifier& OutputVerifier::instance()
+{
+   static OutputVerifier verifier;
+   return verifier;
+}
+
+
+OutputVerifier::OutputVerifier() :
+   _period(DEFAULT_PERIOD),
+   _executing(false),
+   _stop(false),
+   _mismatches(0)
+{
+   _watched.reserve(64);
+   _found.reserve(64);
+
+   _thread = std::thread(&OutputVerifier::run, this);
+   _created = true;
+}
+
+
+OutputVerifier::~OutputVerifier()
+{
+   _created = false; // GPIOs which outlive the verifier have nothing left to remove
+   {
+      std::lock_guard<std::mutex> lck(_mutex);
+      _stop = true;
+      _cv.notify_one();
+   }
+   if( _thread.joinable() )  _thread.join();
+}
+
+
+void OutputVerifier::add(const GPIO& output)
+{
+   if( output.direction() == GPIO::Direction::IN )
+   {
+      raiseError("Cannot verify input GPIO " + std::to_string(output.id()));
+   }
+
+   // The pass in progress reads _watched without the mutex
+   std::unique_lock<std::mutex> lck(_mutex);
+   while( _executing )
+      _idleCV.wait(lck);
+
+   for( const auto& w : _watched )
+   {
+      if( w.output == &output )
+         return;
+   }
+
+   const Watched w = { &output, 0, false };
+   _watched.push_back(w);
+}
+
+
+void OutputVerifier::remove(const GPIO& output)
+{
+   if( !_created )
+      return;
+
+   OutputVerifier& v = instance();
+   std::unique_lock<std::mutex> lck(v._mutex);
+
+   // The pass in progress may still refer to output, and reads _watched without the mutex
+   while( v._executing )
+      v._idleCV.wait(lck);
+
+   v._watched.erase(
+      std::remove_if(v._watched.begin(), v._watched.end(),
+                     [&output](const Watched& w) { return w.output == &output; }),
+      v._watched.end());
+}
+
+
+void OutputVerifier::setPeriod(const GPIO::Clock::duration period)
+{
+   std::lock_guard<std::mutex> lck(_mutex);
+   _period = period;
+   _cv.notify_one();
+}
+
+
+void OutputVerifier::setHandler(std::function<void(const Mismatch&)> handler)
+{
+   std::lock_guard<std::mutex> lck(_mutex);
+   _handler = std::move(handler);
+}
+
+
+void OutputVerifier::run()
+{
+   std::unique_lock<std::mutex> lck(_mutex);
+   GPIO::TimePoint next = GPIO::Clock::now() + _period;
+   while( !_stop )
+   {
+      if( _cv.wait_until(lck, next) != std::cv_status::timeout )
+         continue; // Stopped, or the period changed
+
+      const GPIO::TimePoint now = GPIO::Clock::now();
+      next = now + _period;
+
+      // Outputs are neither added nor removed during the pass, so _watched is stable
+      _executing = true;
+      lck.unlock();
+      verify(now);
+      lck.lock();
+      _executing = false;
+      _idleCV.notify_all();
+
+      if( _found.empty() )
+         continue;
+
+      // Reported without holding the mutex, so that the handler may add or remove outputs
+      const std::function<void(const Mismatch&)> handler = _handler;
+      std::vector<Mismatch> found;
+      found.swap(_found);
+      lck.unlock();
+
+      for( const auto& m : found )
+      {
+         if( handler )
+         {
+            handler(m);
+         }
+         else
+         {
+            std::cerr << "GPIO " << m.id << " should be "
+                      << (m.expected == GPIO::Value::HIGH ? "HIGH" : "LOW") << " but is "
+                      << (m.actual   == GPIO::Value::HIGH ? "HIGH" : "LOW") << std::endl;
+         }
+      }
+
+      found.clear();
+      lck.lock();
+      _found.swap(found); // Keep the capacity
+   }
+}
+
+
+void OutputVerifier::verify(const GPIO::TimePoint now)
+{
+   for( auto& w : _watched )
+   {
+      const GPIO& output = *w.output;
+
+      // A queued write, or a lost chip, leaves the pin legitimately different from the shadow
+      if( output._lost || output._dirty )
+         continue;
+
+      const char expected = output._shadow;
+      char actual;
+      if( pread(output._valueFD, &actual, 1, 0) != 1 )
+      {
+         perror("pread");
+         continue;
+      }
+      if( output._shadow != expected || (actual != '0' && actual != '1') )
+         continue;
+
+      if( actual == expected )
+      {
+         w.suspect  = 0;
+         w.reported = false;
+         continue;
+      }
+
+      // The value may have been set just before the read, and written just after it
+      if( w.suspect != expected )
+      {
+         w.suspect = expected;
+         continue;
+      }
+
+      if( !w.reported )
+      {
+         w.reported = true;
+         ++_mismatches;
+
+         const Mismatch m = {
+            output.id(),
+            expected == '1' ? GPIO::Value::HIGH : GPIO::Value::LOW,
+            actual   == '1' ? GPIO::Value::HIGH : GPIO::Value::LOW,
+            now };
+         std::lock_guard<std::mutex> lck(_mutex);
+         _found.push_back(m);
+      }
+   }
+}
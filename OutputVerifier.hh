@@ -0,0 +1,158 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2014 Thomas Mercier Jr.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef OUTPUTVERIFIER_HH
+#define OUTPUTVERIFIER_HH
+
+#include "GPIO.hh"
+#include "Uncopyable.hh"
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+//--------------------------------------------------------------------------------------------------
+/// @class OutputVerifier
+/// @brief Periodically reads back the level of registered outputs, and reports those which do not
+///        hold the value last set (a pin shorted to a rail, or driven by something else).
+///
+/// Meant to accompany GPIO::setShadowReads(): the program reads outputs from their shadow values,
+/// at no cost, and the pins are checked once per period by one thread, in a single pass over all
+/// registered outputs. An output with a write still queued (see GPIO::setAsync()), or whose value
+/// changes while it is being read, is skipped for that period. A mismatch is reported only after
+/// it has been seen on two consecutive periods with the same expected value, so that a value set
+/// just before its pin is read is not mistaken for a fault, and only once until the pin matches
+/// again.
+///
+/// Whether a read-back reflects the level of the pin, rather than the value of the output
+/// register, depends on the GPIO controller; most SoC controllers report the pin level.
+///
+/// Usage:
+/// @code
+///    GPIO relay(60, GPIO::Direction::OUT);
+///    relay.setShadowReads(true);
+///    OutputVerifier::instance().setHandler(onMismatch);
+///    OutputVerifier::instance().add(relay);
+/// @endcode
+//--------------------------------------------------------------------------------------------------
+class OutputVerifier : private Uncopyable
+{
+public:
+   /// Interval between read-backs unless setPeriod() is called.
+   static const GPIO::Clock::duration DEFAULT_PERIOD;
+
+   //-----------------------------------------------------------------------------------------------
+   /// @struct Mismatch
+   /// @brief An output found at a level other than the value last set.
+   //-----------------------------------------------------------------------------------------------
+   struct Mismatch
+   {
+      unsigned short  id;       ///< Number of the GPIO
+      GPIO::Value     expected; ///< Value last set
+      GPIO::Value     actual;   ///< Value read back
+      GPIO::TimePoint when;     ///< Time of the read which confirmed the mismatch
+   };
+
+
+   /// The process-wide verifier. Its thread is started on first use.
+   static OutputVerifier& instance();
+
+
+   //-----------------------------------------------------------------------------------------------
+   // FUNCTION NAME: add
+   ///
+   /// @brief Read back output once per period from now on. Adding an output twice has no effect.
+   ///
+   //-----------------------------------------------------------------------------------------------
+   void add(const GPIO& output);
+
+
+   //-----------------------------------------------------------------------------------------------
+   // FUNCTION NAME: remove
+   ///
+   /// @brief Stop reading back output, waiting for any read-back in progress. Does nothing if the
+   ///        verifier has never been used, or output was not added.
+   ///
+   //-----------------------------------------------------------------------------------------------
+   static void remove(const GPIO& output);
+
+
+   /// Change the interval between read-backs. Takes effect after the current interval.
+   void setPeriod(GPIO::Clock::duration period);
+
+
+   //-----------------------------------------------------------------------------------------------
+   // FUNCTION NAME: setHandler
+   ///
+   /// @brief Replace the function called, from the verifier thread, for each mismatch found. An
+   ///        empty function restores the default, which prints the mismatch on stderr.
+   ///
+   /// @note The handler may call add() and remove().
+   ///
+   //-----------------------------------------------------------------------------------------------
+   void setHandler(std::function<void(const Mismatch&)> handler);
+
+
+   /// Number of mismatches reported so far.
+   unsigned long mismatches() const { return _mismatches; }
+
+private:
+   OutputVerifier();
+   ~OutputVerifier();
+
+   void run();
+   void verify(const GPIO::TimePoint now);
+
+   struct Watched
+   {
+      const GPIO* output;
+      char        suspect;  // expected value of a mismatch seen once, or 0
+      bool        reported; // mismatch reported, and not matched since
+   };
+
+private:
+   static std::atomic<bool> _created;
+
+   mutable std::mutex      _mutex;
+   std::condition_variable _cv;     // signalled when _period or _stop change
+   std::condition_variable _idleCV; // signalled when a read-back pass has finished
+
+   std::vector<Watched>   _watched;
+   std::vector<Mismatch>  _found;   // of the current pass, reported once the pass has finished
+   GPIO::Clock::duration  _period;
+   bool                   _executing;
+   bool                   _stop;
+
+   std::function<void(const Mismatch&)> _handler;
+
+   std::atomic<unsigned long> _mismatches;
+
+   std::thread _thread;
+};
+
+#endif
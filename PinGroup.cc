@@ -0,0 +1,76 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2014 Thomas Mercier Jr.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "PinGroup.hh"
+
+#include <iostream>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+
+
+PinGroup::~PinGroup()
+{
+   shutdown();
+}
+
+
+void PinGroup::shutdown()
+{
+   if( _pins.empty() )
+      return;
+
+   // Signal every thread before waiting for any, so that they all wind down at the same time
+   for( auto& pin : _pins )
+      pin->stop();
+
+   for( auto& pin : _pins )
+      pin->release();
+
+   // One open of the unexport file for the whole group. A write is still needed per GPIO, since the
+   // kernel accepts a single number per write.
+   const std::string path(GPIO::_sysfsPath + "unexport");
+   const int fd = open(path.c_str(), O_WRONLY);
+   if( fd < 0 )
+   {
+      perror("open");
+   }
+   else
+   {
+      for( auto& pin : _pins )
+      {
+         if( pin->_exported &&
+             write(fd, pin->_id_str.data(), pin->_id_str.size()) ==
+                static_cast<ssize_t>(pin->_id_str.size()) )
+         {
+            pin->_exported = false;
+         }
+      }
+      close(fd);
+   }
+
+   // Anything left exported is retried, and reported, by the GPIO destructor
+   _pins.clear();
+}
@@ -0,0 +1,88 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2014 Thomas Mercier Jr.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef PINGROUP_HH
+#define PINGROUP_HH
+
+#include "GPIO.hh"
+#include "Uncopyable.hh"
+
+#include <cstddef>
+#include <memory>
+#include <utility>
+#include <vector>
+
+
+//--------------------------------------------------------------------------------------------------
+/// @class PinGroup
+/// @brief Owns a set of GPIO objects and tears them down together.
+///
+/// Destroying GPIO objects one at a time stops, joins and unexports each in turn, so shutdown
+/// time grows with the sum of every pin's teardown. shutdown() instead signals the threads of every
+/// GPIO before waiting for any of them, so they all terminate concurrently, and then unexports all
+/// of the GPIOs through a single open of the sysfs unexport file.
+//--------------------------------------------------------------------------------------------------
+class PinGroup : private Uncopyable
+{
+public:
+   PinGroup() = default;
+
+   /// Calls shutdown()
+   ~PinGroup();
+
+
+   //-----------------------------------------------------------------------------------------------
+   // FUNCTION NAME: add
+   ///
+   /// @brief Construct a GPIO owned by this group. Takes the same arguments as the GPIO
+   ///        constructors.
+   ///
+   /// @return The new GPIO, valid until shutdown().
+   ///
+   //-----------------------------------------------------------------------------------------------
+   template<typename... Args>
+   GPIO& add(Args&&... args)
+   {
+      _pins.emplace_back(new GPIO(std::forward<Args>(args)...));
+      return *_pins.back();
+   }
+
+
+   //-----------------------------------------------------------------------------------------------
+   // FUNCTION NAME: shutdown
+   ///
+   /// @brief Stop, unexport and destroy every GPIO in the group. The group is empty afterwards.
+   ///
+   //-----------------------------------------------------------------------------------------------
+   void shutdown();
+
+
+   /// Number of GPIOs in the group.
+   std::size_t size() const { return _pins.size(); }
+
+private:
+   std::vector<std::unique_ptr<GPIO>> _pins;
+};
+
+#endif
@@ -0,0 +1,177 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2014 Thomas Mercier Jr.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef PINMAP_HH
+#define PINMAP_HH
+
+#include "GPIO.hh"
+#include "Uncopyable.hh"
+
+#include <array>
+#include <cstddef>
+#include <memory>
+
+
+//--------------------------------------------------------------------------------------------------
+/// @brief Describes one entry of a PinMap.
+///
+/// @tparam Id       The GPIO ID.
+/// @tparam Dir      The direction of the GPIO.
+/// @tparam E        For inputs, the transitions which call Handler. Must be NONE for outputs.
+/// @tparam Handler  For inputs with an edge, the function called for every transition. It is
+///                  called directly, from the thread which detects the transition, with no
+///                  std::function and no hand-off to a second thread, so it must be short.
+//--------------------------------------------------------------------------------------------------
+template<unsigned short Id,
+         GPIO::Direction Dir,
+         GPIO::Edge E = GPIO::Edge::NONE,
+         void (*Handler)(GPIO::Value) = nullptr>
+struct Pin
+{
+   static_assert(Dir == GPIO::Direction::IN || E == GPIO::Edge::NONE,
+                 "An output cannot have an edge");
+   static_assert(Dir == GPIO::Direction::IN || Handler == nullptr,
+                 "An output cannot have a handler");
+   static_assert((E == GPIO::Edge::NONE) == (Handler == nullptr),
+                 "An input has a handler if and only if it has an edge");
+
+   static constexpr unsigned short id = Id;
+
+   static GPIO* create()
+   {
+      if( E == GPIO::Edge::NONE )
+         return new GPIO(Id, Dir);
+
+      // Stateless, so one instance serves every PinMap containing this pin
+      static Dispatch sink;
+      return new GPIO(Id, E, sink);
+   }
+
+private:
+   class Dispatch : public GPIO::EdgeSink
+   {
+   public:
+      void onEdge(unsigned short, GPIO::Value value, GPIO::TimePoint) override
+      {
+         if( Handler != nullptr )
+            Handler(value);
+      }
+   };
+};
+
+
+namespace PinMapDetail
+{
+   constexpr bool contains(unsigned short) { return false; }
+
+   template<typename... Rest>
+   constexpr bool contains(unsigned short id, unsigned short first, Rest... rest)
+   { return id == first || contains(id, rest...); }
+
+   constexpr bool unique() { return true; }
+
+   template<typename... Rest>
+   constexpr bool unique(unsigned short first, Rest... rest)
+   { return !contains(first, rest...) && unique(rest...); }
+
+   constexpr std::size_t indexOf(unsigned short, std::size_t) { return ~std::size_t(0); }
+
+   template<typename... Rest>
+   constexpr std::size_t indexOf(unsigned short id, std::size_t i, unsigned short first, Rest... rest)
+   { return id == first ? i : indexOf(id, i + 1, rest...); }
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/// @class PinMap
+/// @brief A fixed set of GPIOs described entirely at compile time.
+///
+/// The map is validated by the compiler (unique IDs, no edges or handlers on outputs, a handler
+/// for every input with an edge), so a mistake in it is a build failure rather than an exception
+/// at startup. GPIOs are looked up by ID at compile time, and transitions are dispatched to
+/// handlers through per-pin function pointers known at compile time rather than through
+/// std::function.
+///
+/// Each GPIO is still constructed by the ordinary GPIO constructors, so startup costs the same as
+/// constructing the GPIOs by hand: the checks of each GPIO against the kernel (its gpiochip, and
+/// whether it is already exported) and its configuration through sysfs.
+///
+/// Usage:
+/// @code
+///    void onButton(GPIO::Value);
+///
+///    PinMap<Pin<27, GPIO::Direction::OUT>,
+///           Pin<15, GPIO::Direction::IN, GPIO::Edge::RISING, &onButton>> pins;
+///    pins.pin<27>().setValue(GPIO::Value::HIGH);
+/// @endcode
+///
+/// @note GPIOs are constructed in the order listed, and destroyed in the reverse order.
+//--------------------------------------------------------------------------------------------------
+template<typename... Pins>
+class PinMap : private Uncopyable
+{
+   static_assert(sizeof...(Pins) > 0, "A PinMap must contain at least one pin");
+   static_assert(PinMapDetail::unique(Pins::id...), "Every pin of a PinMap must be unique");
+
+public:
+   static constexpr std::size_t size = sizeof...(Pins);
+
+   PinMap() { init<0, Pins...>(); }
+
+   ~PinMap()
+   {
+      for( std::size_t i = size; i > 0; --i )
+         _gpios[i - 1].reset();
+   }
+
+   /// The GPIO with ID Id, resolved at compile time.
+   template<unsigned short Id>
+   GPIO& pin()
+   {
+      static_assert(PinMapDetail::indexOf(Id, 0, Pins::id...) < size, "No such pin in this PinMap");
+      return *_gpios[PinMapDetail::indexOf(Id, 0, Pins::id...)];
+   }
+
+   /// The GPIO at position index of the map.
+   GPIO& operator[](std::size_t index) { return *_gpios[index]; }
+
+private:
+   template<std::size_t I>
+   void init() {}
+
+   template<std::size_t I, typename P, typename... Rest>
+   void init()
+   {
+      _gpios[I].reset(P::create());
+      init<I + 1, Rest...>();
+   }
+
+private:
+   std::array<std::unique_ptr<GPIO>, sizeof...(Pins)> _gpios;
+};
+
+template<typename... Pins>
+constexpr std::size_t PinMap<Pins...>::size;
+
+#endif
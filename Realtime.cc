@@ -0,0 +1,110 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2014 Thomas Mercier Jr.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "Realtime.hh"
+
+#include <algorithm>
+#include <cstdio>
+
+#include <alloca.h>
+#include <malloc.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+
+
+const std::size_t Realtime::DEFAULT_STACK_PREFAULT;
+const std::size_t Realtime::DEFAULT_THREAD_STACK;
+
+std::atomic<std::size_t> Realtime::_stackPrefault(0);
+
+
+Result<void> Realtime::init(std::size_t stackPrefault, std::size_t threadStack)
+{
+   threadStack = std::max<std::size_t>(threadStack ? threadStack : DEFAULT_THREAD_STACK,
+                                       PTHREAD_STACK_MIN);
+
+   // Freed memory is kept by malloc rather than trimmed or unmapped, and large blocks come from the
+   // (locked) heap rather than from fresh mappings, so that it never has to be faulted in again
+   mallopt(M_TRIM_THRESHOLD, -1);
+   mallopt(M_MMAP_MAX, 0);
+
+   // Threads share the main heap: the 64 MiB which malloc reserves for each additional arena would
+   // otherwise be locked by the first allocation of every new thread
+   mallopt(M_ARENA_MAX, 1);
+
+   // The prefaulted part must fit in the stack of a thread, with room for the frames below it
+   _stackPrefault = std::min(stackPrefault ? stackPrefault : DEFAULT_STACK_PREFAULT,
+                             threadStack / 2);
+   prefaultStack();
+
+   // mlockall(MCL_FUTURE) locks, and counts against RLIMIT_MEMLOCK, the whole stack of a thread
+   // when it is mapped (even with MCL_ONFAULT). With the default stack size, usually 8 MiB, an
+   // unprivileged process could not start a single thread, so threads started from now on, by the
+   // library (std::thread uses the default attributes) or by the caller, get bounded stacks.
+   {
+      pthread_attr_t attr;
+      pthread_attr_init(&attr);
+      int rc = pthread_attr_setstacksize(&attr, threadStack);
+      if( rc == 0 )
+         rc = pthread_setattr_default_np(&attr);
+      pthread_attr_destroy(&attr);
+      if( rc != 0 )
+      {
+         return Result<void>::failure("Unable to bound the stack size of threads");
+      }
+   }
+
+   if( mlockall(MCL_CURRENT | MCL_FUTURE) != 0 )
+   {
+      perror("mlockall");
+      return Result<void>::failure("Unable to lock memory");
+   }
+   return Result<void>();
+}
+
+
+void Realtime::prefaultStack()
+{
+   const std::size_t bytes = _stackPrefault;
+   if( bytes == 0 )
+      return;
+
+   // The pages stay mapped (and, after mlockall(), locked) when this frame is popped
+   volatile char* const stack = static_cast<volatile char*>(alloca(bytes));
+   const std::size_t page = sysconf(_SC_PAGESIZE);
+   for( std::size_t i = 0; i < bytes; i += page )
+      stack[i] = 0;
+}
+
+
+unsigned long Realtime::minorFaults()
+{
+   struct rusage usage;
+   if( getrusage(RUSAGE_THREAD, &usage) != 0 )
+      return 0;
+   return usage.ru_minflt;
+}
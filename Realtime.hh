@@ -0,0 +1,116 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2014 Thomas Mercier Jr.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef REALTIME_HH
+#define REALTIME_HH
+
+#include "Result.hh"
+
+#include <atomic>
+#include <cstddef>
+
+
+//--------------------------------------------------------------------------------------------------
+/// @class Realtime
+/// @brief Process-wide setup which keeps page faults off the path from a transition to its
+///        callback function.
+///
+/// init() locks all current and future memory of the process (mlockall), and stops malloc from
+/// returning memory to the kernel, so that memory once touched stays resident. Every thread the
+/// library starts afterwards prefaults its stack before entering its loop. Nothing is added to
+/// the path of a transition.
+///
+/// A locked thread stack counts in full against RLIMIT_MEMLOCK, so init() also makes threads
+/// started afterwards (the library's, and those of the caller which do not choose their own stack
+/// size) use threadStack bytes of stack rather than the default, usually 8 MiB, and has malloc
+/// serve every thread from the main heap rather than reserve 64 MiB for each. Otherwise, with an
+/// unprivileged limit such as "ulimit -l 8192", the first thread started after init() fails.
+/// Callback functions and EdgeSinks run on these threads, so must not need deeper stacks.
+///
+/// To check the result while commissioning, GPIO::countPageFaults() has the threads of a GPIO
+/// count the minor page faults they take while handling transitions (at the cost of a getrusage()
+/// call per transition); the count, GPIO::pageFaults(), should stay at zero in steady state.
+///
+/// Once a GPIO is constructed, neither the path of a transition (detection, queue, EdgeSink,
+/// callback function) nor setValue() and getValue() allocate heap memory, other than to report an
+/// error: the queues are fixed rings, and the sysfs paths are built by the constructor. Replacing
+/// handlers (setCallback(), setSink()) allocates, as does the first use of diagnostics.
+/// test/alloc ("make check") counts the allocations of a million transitions and of a million
+/// setValue()/getValue() pairs, and fails if there are any. Page fault counts cannot show this,
+/// since after init() an allocation is usually served from memory which is already resident.
+///
+/// Call init() once, before constructing any GPIO, typically at the start of main().
+///
+/// Usage:
+/// @code
+///    Realtime::init();
+///    GPIO button(15, GPIO::Edge::BOTH, onButton);
+///    button.countPageFaults(true); // commissioning only
+///    ...
+///    assert(button.pageFaults() == 0);
+/// @endcode
+//--------------------------------------------------------------------------------------------------
+class Realtime
+{
+public:
+   static const std::size_t DEFAULT_STACK_PREFAULT = 64 * 1024;
+   static const std::size_t DEFAULT_THREAD_STACK   = 256 * 1024;
+
+
+   //-----------------------------------------------------------------------------------------------
+   // FUNCTION NAME: init
+   ///
+   /// @brief Bound the stacks of threads started from now on, lock memory, keep freed memory
+   ///        resident, and enable stack prefaulting.
+   ///
+   /// @param[in]   stackPrefault  Bytes of stack each library thread touches before its loop. At
+   ///                             most half of threadStack.
+   /// @param[in]   threadStack    Stack size of threads started after this call.
+   ///
+   /// @return Success, or the reason memory could not be locked (usually RLIMIT_MEMLOCK, or the
+   ///         lack of CAP_IPC_LOCK). Prefaulting is enabled either way.
+   ///
+   //-----------------------------------------------------------------------------------------------
+   static Result<void> init(std::size_t stackPrefault = DEFAULT_STACK_PREFAULT,
+                            std::size_t threadStack   = DEFAULT_THREAD_STACK);
+
+
+   /// Whether init() has been called.
+   static bool enabled() { return _stackPrefault != 0; }
+
+
+   /// Touch the configured amount of the calling thread's stack. Does nothing before init().
+   static void prefaultStack();
+
+
+   /// Minor page faults taken by the calling thread so far.
+   static unsigned long minorFaults();
+
+private:
+   Realtime() = delete;
+
+   static std::atomic<std::size_t> _stackPrefault; // 0 until init()
+};
+
+#endif
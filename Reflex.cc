@@ -0,0 +1,101 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2014 Thomas Mercier Jr.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "Reflex.hh"
+#include "Result.hh"
+
+#include <iostream>
+#include <string>
+
+
+
+Reflex::Reflex(GPIO::EdgeSink* next) :
+   _next(next),
+   _failures(0)
+{}
+
+
+Reflex& Reflex::on(GPIO::Edge edge, const GPIO& output, GPIO::Value value)
+{
+   if( output.direction() != GPIO::Direction::OUT )
+   {
+      raiseError(
+         "Reflex target GPIO " + std::to_string(output.id()) + " is not an output");
+   }
+   if( edge == GPIO::Edge::NONE )
+   {
+      raiseError("Reflex rule must specify an edge");
+   }
+
+   Rule rule;
+   rule.trigger  = (edge == GPIO::Edge::FALLING) ? GPIO::Value::LOW : GPIO::Value::HIGH;
+   rule.anyValue = (edge == GPIO::Edge::BOTH);
+   rule.output   = &output;
+   rule.value    = value;
+   _rules.push_back(rule);
+
+   return *this;
+}
+
+
+void Reflex::onInitial(unsigned short id, GPIO::Value value, GPIO::TimePoint when)
+{
+   if( _next != nullptr )
+      _next->onInitial(id, value, when);
+}
+
+
+void Reflex::onEdge(unsigned short id, GPIO::Value value, GPIO::TimePoint when)
+{
+   for( const auto& rule : _rules )
+   {
+      if( !rule.anyValue && rule.trigger != value )
+         continue;
+
+      // Called from the detection thread, where a throw would end the process. A lost output
+      // (e.g. an unplugged expander) fails here until its chip returns.
+      const Result<void> r = rule.output->trySetValue(rule.value);
+      if( !r )
+      {
+         ++_failures;
+         std::cerr << "Reflex failed: " << r.error() << std::endl;
+      }
+   }
+
+   if( _next != nullptr )
+      _next->onEdge(id, value, when);
+}
+
+
+GPIO::Clock::duration Reflex::idleTimeout() const
+{
+   return (_next != nullptr) ? _next->idleTimeout() : GPIO::Clock::duration::max();
+}
+
+
+void Reflex::onIdle(unsigned short id, GPIO::TimePoint now)
+{
+   if( _next != nullptr )
+      _next->onIdle(id, now);
+}
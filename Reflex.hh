@@ -0,0 +1,108 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2014 Thomas Mercier Jr.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef REFLEX_HH
+#define REFLEX_HH
+
+#include "GPIO.hh"
+#include "Uncopyable.hh"
+
+#include <atomic>
+#include <vector>
+
+
+//--------------------------------------------------------------------------------------------------
+/// @class Reflex
+/// @brief Edge-to-output rules, such as "when this input rises, set GPIO 27 low", executed directly
+///        in the thread which detects the transition. The reaction is a single write to the
+///        output's already open value file; it does not wait for the hand-off to the thread which
+///        calls the user-provided callback function.
+///
+/// A Reflex serves one input GPIO. Rules are applied in the order in which they were added, before
+/// the transition is passed to the next sink (if any) or queued for the callback function.
+///
+/// Usage:
+/// @code
+///    GPIO   out(27, GPIO::Direction::OUT);
+///    Reflex reflex;
+///    reflex.on(GPIO::Edge::RISING, out, GPIO::Value::LOW);
+///    GPIO   in(15, GPIO::Edge::BOTH, reflex, myisr);
+/// @endcode
+//--------------------------------------------------------------------------------------------------
+class Reflex : public GPIO::EdgeSink, private Uncopyable
+{
+public:
+
+   //-----------------------------------------------------------------------------------------------
+   // FUNCTION NAME: Reflex (constructor)
+   ///
+   /// @param[in]   next  Optional sink to which every transition is passed after the rules have
+   ///                    been applied. Must outlive this object.
+   ///
+   //-----------------------------------------------------------------------------------------------
+   explicit Reflex(GPIO::EdgeSink* next = nullptr);
+
+
+   //-----------------------------------------------------------------------------------------------
+   // FUNCTION NAME: on
+   ///
+   /// @brief Add a rule: on transitions of type edge, set output to value. All rules must be added
+   ///        before the input GPIO is constructed.
+   ///
+   /// @param[in]   edge    The transitions which trigger the rule.
+   /// @param[in]   output  An output GPIO. Must outlive the input GPIO.
+   /// @param[in]   value   The value to which output is set.
+   ///
+   /// @return *this, so rules can be chained.
+   ///
+   //-----------------------------------------------------------------------------------------------
+   Reflex& on(GPIO::Edge edge, const GPIO& output, GPIO::Value value);
+
+
+   /// Number of rule writes which failed. Each failure is also reported on stderr.
+   unsigned long failures() const { return _failures; }
+
+
+   // GPIO::EdgeSink
+   void onInitial(unsigned short id, GPIO::Value value, GPIO::TimePoint when) override;
+   void onEdge(unsigned short id, GPIO::Value value, GPIO::TimePoint when) override;
+   GPIO::Clock::duration idleTimeout() const override;
+   void onIdle(unsigned short id, GPIO::TimePoint now) override;
+
+private:
+   struct Rule
+   {
+      GPIO::Value trigger;
+      bool        anyValue;
+      const GPIO* output;
+      GPIO::Value value;
+   };
+
+   std::vector<Rule>     _rules;
+   GPIO::EdgeSink* const _next;
+
+   std::atomic<unsigned long> _failures;
+};
+
+#endif
@@ -0,0 +1,144 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2014 Thomas Mercier Jr.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef RESULT_HH
+#define RESULT_HH
+
+#include <string>
+#include <utility>
+
+// GPIO_EXCEPTIONS is 0 when compiling with -fno-exceptions (see the noexceptions and
+// lib-noexceptions make targets). In that case every error which would have been thrown is instead
+// printed to stderr, and the process is aborted. Programs which must survive errors should use the
+// functions returning Result, such as GPIO::create(), which report errors without exceptions in
+// either build.
+#if defined(__cpp_exceptions) || defined(__EXCEPTIONS)
+   #define GPIO_EXCEPTIONS 1
+   #include <stdexcept>
+#else
+   #define GPIO_EXCEPTIONS 0
+   #include <cstdio>
+   #include <cstdlib>
+#endif
+
+
+//--------------------------------------------------------------------------------------------------
+// FUNCTION NAME: raiseError
+///
+/// @brief Throw std::runtime_error(what), or print what and abort if exceptions are disabled.
+///
+//--------------------------------------------------------------------------------------------------
+[[noreturn]] inline void raiseError(const std::string& what)
+{
+#if GPIO_EXCEPTIONS
+   throw std::runtime_error(what);
+#else
+   std::fprintf(stderr, "%s\n", what.c_str());
+   std::abort();
+#endif
+}
+
+
+//--------------------------------------------------------------------------------------------------
+/// @class Result
+/// @brief Either a value of type T or a description of the error which prevented producing one.
+//--------------------------------------------------------------------------------------------------
+template<typename T>
+class Result
+{
+public:
+   Result(T value) : _value(std::move(value)), _error(), _failed(false) {}
+
+   static Result failure(std::string error)
+   {
+      Result r;
+      r._error  = std::move(error);
+      r._failed = true;
+      return r;
+   }
+
+   bool ok() const { return !_failed; }
+   explicit operator bool() const { return !_failed; }
+
+   /// Only meaningful if ok()
+   T&       value()       { return _value; }
+   const T& value() const { return _value; }
+
+   /// Empty if ok()
+   const std::string& error() const { return _error; }
+
+   /// The value, or raiseError() with the error
+   T orRaise()
+   {
+      if( _failed )
+         raiseError(_error);
+      return std::move(_value);
+   }
+
+private:
+   Result() : _value(), _error(), _failed(false) {}
+
+   T           _value;
+   std::string _error;
+   bool        _failed;
+};
+
+
+//--------------------------------------------------------------------------------------------------
+/// @class Result<void>
+/// @brief Success, or a description of the error which occurred.
+//--------------------------------------------------------------------------------------------------
+template<>
+class Result<void>
+{
+public:
+   Result() : _error(), _failed(false) {}
+
+   static Result failure(std::string error)
+   {
+      Result r;
+      r._error  = std::move(error);
+      r._failed = true;
+      return r;
+   }
+
+   bool ok() const { return !_failed; }
+   explicit operator bool() const { return !_failed; }
+
+   /// Empty if ok()
+   const std::string& error() const { return _error; }
+
+   /// raiseError() with the error, if any
+   void orRaise() const
+   {
+      if( _failed )
+         raiseError(_error);
+   }
+
+private:
+   std::string _error;
+   bool        _failed;
+};
+
+#endif
@@ -0,0 +1,157 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2014 Thomas Mercier Jr.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "SafeState.hh"
+#include "Result.hh"
+
+#include <atomic>
+#include <cerrno>
+#include <string>
+
+#include <signal.h>
+#include <string.h>
+#include <unistd.h>
+
+
+
+const std::size_t SafeState::MAX_OUTPUTS;
+
+
+namespace
+{
+   static_assert(ATOMIC_POINTER_LOCK_FREE == 2 && ATOMIC_INT_LOCK_FREE == 2 &&
+                 ATOMIC_CHAR_LOCK_FREE == 2,
+                 "The safe state table must be readable from a signal handler");
+
+   // Every field is a lock-free atomic, so the handler may read entries which are being changed by
+   // another thread. An entry is in use while owner is non-null, and armed while armedFD is
+   // non-zero. armedFD holds the value file descriptor plus one, so that the table, which is
+   // zero-initialized before any code runs, starts disarmed rather than aimed at descriptor 0.
+   struct Entry
+   {
+      std::atomic<const GPIO*> owner;
+      std::atomic<int>         armedFD;
+      std::atomic<char>        value;
+   };
+
+   Entry entries[SafeState::MAX_OUTPUTS];
+
+   const int signals[] = { SIGSEGV, SIGBUS, SIGILL, SIGFPE, SIGABRT, SIGTERM };
+}
+
+
+void SafeState::install()
+{
+   struct sigaction action;
+   memset(&action, 0, sizeof(action));
+   action.sa_handler = &SafeState::handler;
+   action.sa_flags   = SA_RESETHAND; // the default action is taken when the signal is re-raised
+   sigfillset(&action.sa_mask);
+
+   for( const int sig : signals )
+   {
+      if( sigaction(sig, &action, nullptr) != 0 )
+      {
+         perror("sigaction");
+         raiseError("Unable to install safe state handler for signal " +
+                                  std::to_string(sig));
+      }
+   }
+}
+
+
+void SafeState::add(const GPIO& output, GPIO::Value value)
+{
+   if( output.direction() != GPIO::Direction::OUT )
+   {
+      raiseError(
+         "Cannot register safe state for input GPIO " + std::to_string(output.id()));
+   }
+
+   const char c = (value == GPIO::Value::HIGH) ? '1' : '0';
+
+   for( auto& e : entries )
+   {
+      if( e.owner == &output )
+      {
+         e.value = c;
+         return;
+      }
+   }
+
+   for( auto& e : entries )
+   {
+      const GPIO* expected = nullptr;
+      if( e.owner.compare_exchange_strong(expected, &output) )
+      {
+         e.value = c;
+         e.armedFD = output._valueFD + 1; // armed last
+         return;
+      }
+   }
+
+   raiseError(
+      "Safe state registry is full (" + std::to_string(MAX_OUTPUTS) + " outputs)");
+}
+
+
+void SafeState::remove(const GPIO& output)
+{
+   for( auto& e : entries )
+   {
+      if( e.owner == &output )
+      {
+         e.armedFD = 0; // disarmed first
+         e.owner = nullptr;
+         return;
+      }
+   }
+}
+
+
+void SafeState::apply()
+{
+   for( auto& e : entries )
+   {
+      const int fd = e.armedFD - 1;
+      if( fd >= 0 )
+      {
+         // sysfs ignores the file offset, and pwrite() is not async-signal-safe
+         const char c = e.value;
+         if( write(fd, &c, 1) != 1 ) {}
+      }
+   }
+}
+
+
+void SafeState::handler(int sig)
+{
+   const int saved = errno;
+   apply();
+   errno = saved;
+
+   // The handler was reset to the default by SA_RESETHAND. The signal is blocked until this
+   // function returns, at which point the default action is taken.
+   raise(sig);
+}
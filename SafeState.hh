@@ -0,0 +1,100 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2014 Thomas Mercier Jr.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef SAFESTATE_HH
+#define SAFESTATE_HH
+
+#include "GPIO.hh"
+
+#include <cstddef>
+
+
+//--------------------------------------------------------------------------------------------------
+/// @class SafeState
+/// @brief Process-wide registry of the values to which outputs should be driven if the process
+///        crashes or is terminated.
+///
+/// The registry is a fixed-size table of (value file descriptor, safe value) pairs, allocated
+/// statically. Once install() has been called, SIGSEGV, SIGBUS, SIGILL, SIGFPE, SIGABRT and SIGTERM
+/// drive every registered output to its safe value using only write(), which is
+/// async-signal-safe, before the signal's default action (usually termination) is taken.
+///
+/// Usage:
+/// @code
+///    SafeState::install();
+///    GPIO heater(27, GPIO::Direction::OUT);
+///    SafeState::add(heater, GPIO::Value::LOW);
+/// @endcode
+///
+/// @note Outputs are removed from the registry automatically when destroyed.
+//--------------------------------------------------------------------------------------------------
+class SafeState
+{
+public:
+   static const std::size_t MAX_OUTPUTS = 64;
+
+
+   //-----------------------------------------------------------------------------------------------
+   // FUNCTION NAME: install
+   ///
+   /// @brief Install the signal handlers. Replaces any existing handlers for these signals.
+   ///
+   //-----------------------------------------------------------------------------------------------
+   static void install();
+
+
+   //-----------------------------------------------------------------------------------------------
+   // FUNCTION NAME: add
+   ///
+   /// @brief Register output to be driven to value on a crash. Registering an output again
+   ///        replaces its safe value.
+   ///
+   //-----------------------------------------------------------------------------------------------
+   static void add(const GPIO& output, GPIO::Value value);
+
+
+   //-----------------------------------------------------------------------------------------------
+   // FUNCTION NAME: remove
+   ///
+   /// @brief Stop driving output to a safe value. Does nothing if output is not registered.
+   ///
+   //-----------------------------------------------------------------------------------------------
+   static void remove(const GPIO& output);
+
+
+   //-----------------------------------------------------------------------------------------------
+   // FUNCTION NAME: apply
+   ///
+   /// @brief Drive every registered output to its safe value now. Async-signal-safe.
+   ///
+   //-----------------------------------------------------------------------------------------------
+   static void apply();
+
+private:
+   SafeState() = delete;
+
+   static void handler(int sig);
+};
+
+#endif
@@ -0,0 +1,127 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2014 Thomas Mercier Jr.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "SoftUart.hh"
+#include "Result.hh"
+
+
+
+const unsigned int SoftUart::FRAME_BITS;
+
+
+SoftUart::SoftUart(unsigned int baud) :
+   _bitTime(std::chrono::duration_cast<GPIO::Clock::duration>(
+      std::chrono::duration<double>(1.0 / (baud ? baud : 1)))),
+   _inFrame(false),
+   _frameStart(),
+   _level(GPIO::Value::HIGH),
+   _nextBit(0),
+   _shift(0),
+   _framingErrors(0),
+   _overruns(0)
+{
+   if( baud == 0 )
+   {
+      raiseError("SoftUart baud rate must be non-zero");
+   }
+}
+
+
+bool SoftUart::read(unsigned char& byte)
+{
+   return _rx.pop(byte);
+}
+
+
+std::size_t SoftUart::read(unsigned char* buf, std::size_t len)
+{
+   return _rx.pop(buf, len);
+}
+
+
+void SoftUart::onEdge(unsigned short /*id*/, GPIO::Value value, GPIO::TimePoint when)
+{
+   // The line held its previous level from the last transition until now
+   if( _inFrame )
+      sampleUntil(when);
+
+   _level = value;
+
+   // A falling edge while idle (including the one which immediately follows a stop bit) is a
+   // start bit
+   if( !_inFrame && value == GPIO::Value::LOW )
+   {
+      _inFrame    = true;
+      _frameStart = when;
+      _nextBit    = 0;
+      _shift      = 0;
+   }
+}
+
+
+GPIO::Clock::duration SoftUart::idleTimeout() const
+{
+   // Trailing 1 bits and the stop bit produce no transitions, so the detection thread must wake up
+   // on its own to complete the frame. While idle there is nothing to wait for.
+   return _inFrame ? _bitTime * FRAME_BITS : GPIO::Clock::duration::max();
+}
+
+
+void SoftUart::onIdle(unsigned short /*id*/, GPIO::TimePoint now)
+{
+   if( _inFrame )
+      sampleUntil(now);
+}
+
+
+void SoftUart::sampleUntil(GPIO::TimePoint t)
+{
+   // Bit n is sampled at the centre of its bit time
+   while( _nextBit < FRAME_BITS && _frameStart + _bitTime * _nextBit + _bitTime / 2 < t )
+   {
+      if( _level == GPIO::Value::HIGH )
+         _shift |= 1u << _nextBit;
+      ++_nextBit;
+   }
+
+   if( _nextBit == FRAME_BITS )
+      endFrame();
+}
+
+
+void SoftUart::endFrame()
+{
+   _inFrame = false;
+
+   const bool startOk = (_shift & 1u) == 0;
+   const bool stopOk  = (_shift & (1u << (FRAME_BITS - 1))) != 0;
+   if( !startOk || !stopOk )
+   {
+      ++_framingErrors;
+      return;
+   }
+
+   if( !_rx.push(static_cast<unsigned char>(_shift >> 1)) )
+      ++_overruns;
+}
@@ -0,0 +1,127 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2014 Thomas Mercier Jr.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef SOFTUART_HH
+#define SOFTUART_HH
+
+#include "GPIO.hh"
+#include "Uncopyable.hh"
+
+#include <atomic>
+#include <cstddef>
+
+#include <boost/lockfree/spsc_queue.hpp>
+
+
+//--------------------------------------------------------------------------------------------------
+/// @class SoftUart
+/// @brief Software UART receiver for low-rate (up to 9600-19200 baud) serial links. Bytes are
+///        reconstructed from the timestamps of the transitions on the receive line, entirely within
+///        the thread which detects them, and are delivered through a lockfree byte ring. No
+///        callback is made per bit or per byte.
+///
+/// Usage:
+/// @code
+///    SoftUart uart(9600);
+///    GPIO rx(15, GPIO::Edge::BOTH, uart);
+///    unsigned char byte;
+///    while( uart.read(byte) ) { ... }
+/// @endcode
+///
+/// @note The GPIO must be configured for GPIO::Edge::BOTH. The frame format is 8N1, LSB first,
+///       idle high. Each bit is sampled at its centre, so the timestamps of the transitions must
+///       be accurate to better than half of a bit time.
+//--------------------------------------------------------------------------------------------------
+class SoftUart : public GPIO::EdgeSink, private Uncopyable
+{
+public:
+
+   //-----------------------------------------------------------------------------------------------
+   // FUNCTION NAME: SoftUart (constructor)
+   ///
+   /// @param[in]   baud  The bit rate of the serial link.
+   ///
+   //-----------------------------------------------------------------------------------------------
+   explicit SoftUart(unsigned int baud);
+
+
+   //-----------------------------------------------------------------------------------------------
+   // FUNCTION NAME: read
+   ///
+   /// @brief Retrieve the oldest received byte, if any. Must only be called from one thread.
+   ///
+   /// @param[out]  byte  The received byte.
+   ///
+   /// @return true if a byte was retrieved, false if none were available.
+   ///
+   //-----------------------------------------------------------------------------------------------
+   bool read(unsigned char& byte);
+
+
+   //-----------------------------------------------------------------------------------------------
+   // FUNCTION NAME: read
+   ///
+   /// @brief Retrieve up to len received bytes. Must only be called from one thread.
+   ///
+   /// @return The number of bytes written to buf.
+   ///
+   //-----------------------------------------------------------------------------------------------
+   std::size_t read(unsigned char* buf, std::size_t len);
+
+
+   /// Number of frames discarded because the start bit or stop bit was invalid.
+   unsigned long framingErrors() const { return _framingErrors; }
+
+   /// Number of bytes discarded because the byte ring was full.
+   unsigned long overruns() const { return _overruns; }
+
+
+   // GPIO::EdgeSink
+   void onEdge(unsigned short id, GPIO::Value value, GPIO::TimePoint when) override;
+   GPIO::Clock::duration idleTimeout() const override;
+   void onIdle(unsigned short id, GPIO::TimePoint now) override;
+
+private:
+   void sampleUntil(GPIO::TimePoint t);
+   void endFrame();
+
+private:
+   static const unsigned int FRAME_BITS = 10; // start + 8 data + stop
+
+   const GPIO::Clock::duration _bitTime;
+
+   // Decoder state. Only accessed from the thread which detects transitions.
+   bool            _inFrame;
+   GPIO::TimePoint _frameStart;
+   GPIO::Value     _level;
+   unsigned int    _nextBit;
+   unsigned int    _shift;
+
+   boost::lockfree::spsc_queue<unsigned char, boost::lockfree::capacity<256>> _rx;
+
+   std::atomic<unsigned long> _framingErrors;
+   std::atomic<unsigned long> _overruns;
+};
+
+#endif
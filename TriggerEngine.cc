@@ -0,0 +1,141 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2014 Thomas Mercier Jr.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "TriggerEngine.hh"
+#include "Result.hh"
+
+#include <string>
+
+
+
+namespace
+{
+   unsigned char valueBit(GPIO::Value value)
+   { return value == GPIO::Value::HIGH ? 0x1 : 0x2; }
+
+   unsigned char valueMask(GPIO::Edge edge)
+   {
+      if     ( edge == GPIO::Edge::RISING )  return valueBit(GPIO::Value::HIGH);
+      else if( edge == GPIO::Edge::FALLING ) return valueBit(GPIO::Value::LOW);
+      else if( edge == GPIO::Edge::BOTH )    return valueBit(GPIO::Value::HIGH) |
+                                                    valueBit(GPIO::Value::LOW);
+      return 0;
+   }
+}
+
+
+TriggerEngine::Pattern& TriggerEngine::Pattern::then(
+   unsigned short id,
+   GPIO::Edge edge,
+   GPIO::Clock::duration within)
+{
+   const Step step = { id, edge, within };
+   _steps.push_back(step);
+   return *this;
+}
+
+
+void TriggerEngine::arm(const Pattern& pattern, Action action)
+{
+   if( pattern._steps.empty() )
+   {
+      raiseError("Cannot arm an empty trigger pattern");
+   }
+   if( !action )
+   {
+      raiseError("Cannot arm a trigger pattern without an action");
+   }
+
+   std::unique_ptr<Compiled> compiled(new Compiled);
+   compiled->states.reserve(pattern._steps.size());
+   for( const auto& step : pattern._steps )
+   {
+      const State state = { step.id, valueMask(step.edge), step.within };
+      if( state.valueMask == 0 )
+      {
+         raiseError(
+            "Trigger step on GPIO " + std::to_string(step.id) + " must specify an edge");
+      }
+      compiled->states.push_back(state);
+   }
+   compiled->action  = action;
+   compiled->current = 0;
+
+   _patterns.push_back(std::move(compiled));
+}
+
+
+void TriggerEngine::onEdge(unsigned short id, GPIO::Value value, GPIO::TimePoint when)
+{
+   const unsigned char bit = valueBit(value);
+   bool late = false;
+
+   for( auto& p : _patterns )
+   {
+      bool matched = false;
+
+      std::unique_lock<std::mutex> lck(p->mutex);
+
+      // Transitions of different GPIOs are detected by different threads, so one may arrive after
+      // a later transition has already advanced the match. It cannot be placed in the sequence
+      // any more (and the interval to it would be negative), so it is left out.
+      if( p->current > 0 && when < p->last )
+      {
+         lck.unlock();
+         late = true;
+         continue;
+      }
+
+      // A step which was not reached in time abandons the partial match
+      if( p->current > 0 && when - p->last > p->states[p->current].within )
+         p->current = 0;
+
+      if( accepts(p->states[p->current], id, bit) )
+      {
+         p->last = when;
+         if( ++p->current == p->states.size() )
+         {
+            p->current = 0;
+            matched    = true;
+         }
+      }
+      else if( p->current > 0 && accepts(p->states[0], id, bit) )
+      {
+         // A repeat of the first step restarts the sequence from the latest occurrence
+         p->last    = when;
+         p->current = 1;
+      }
+
+      lck.unlock();
+
+      if( matched )
+      {
+         ++_matches;
+         p->action(when);
+      }
+   }
+
+   if( late )
+      ++_late;
+}
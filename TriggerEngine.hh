@@ -0,0 +1,159 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2014 Thomas Mercier Jr.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef TRIGGERENGINE_HH
+#define TRIGGERENGINE_HH
+
+#include "GPIO.hh"
+#include "Uncopyable.hh"
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+
+//--------------------------------------------------------------------------------------------------
+/// @class TriggerEngine
+/// @brief Matches sequences of transitions across several input GPIOs, such as "GPIO 15 rises,
+///        then GPIO 14 falls within 2 ms", and calls a function once per match.
+///
+/// Patterns are compiled into small state machines which are evaluated in the threads which
+/// detect transitions, against the transition timestamps. Nothing is queued and no user code runs
+/// unless a pattern matches.
+///
+/// Usage:
+/// @code
+///    TriggerEngine triggers;
+///    triggers.arm(
+///       TriggerEngine::Pattern()
+///          .then(15, GPIO::Edge::RISING)
+///          .then(14, GPIO::Edge::FALLING, std::chrono::milliseconds(2)),
+///       [](GPIO::TimePoint when) { ... });
+///    GPIO a(15, GPIO::Edge::BOTH, triggers);
+///    GPIO b(14, GPIO::Edge::BOTH, triggers);
+/// @endcode
+//--------------------------------------------------------------------------------------------------
+class TriggerEngine : public GPIO::EdgeSink, private Uncopyable
+{
+public:
+
+   //-----------------------------------------------------------------------------------------------
+   /// @class Pattern
+   /// @brief An ordered sequence of transitions, each of which must follow the previous one
+   ///        within the given time.
+   //-----------------------------------------------------------------------------------------------
+   class Pattern
+   {
+   public:
+      /// Append a step. within is ignored for the first step.
+      Pattern& then(
+         unsigned short id,
+         GPIO::Edge edge,
+         GPIO::Clock::duration within = GPIO::Clock::duration::max());
+
+   private:
+      friend class TriggerEngine;
+
+      struct Step
+      {
+         unsigned short        id;
+         GPIO::Edge            edge;
+         GPIO::Clock::duration within;
+      };
+      std::vector<Step> _steps;
+   };
+
+   /// Called from the detection thread with the timestamp of the transition completing a match.
+   typedef std::function<void(GPIO::TimePoint)> Action;
+
+
+   TriggerEngine() = default;
+
+
+   //-----------------------------------------------------------------------------------------------
+   // FUNCTION NAME: arm
+   ///
+   /// @brief Compile pattern and call action every time it matches. Patterns remain armed after
+   ///        matching. All patterns must be armed before any GPIO which feeds this engine is
+   ///        constructed.
+   ///
+   /// @note action is called from the thread which detected the final transition, and delays
+   ///       detection on that GPIO until it returns. It should be short and should not block.
+   ///
+   /// @note Transitions are evaluated in the order they arrive, not in timestamp order. Each GPIO
+   ///       has its own detection thread, so when steps on different GPIOs occur within the
+   ///       scheduling latency of those threads (tens of microseconds to milliseconds), a step can
+   ///       arrive after the step which follows it, and the match is missed. A transition older
+   ///       than the latest step of a partial match is ignored by that pattern and counted (see
+   ///       late()).
+   ///
+   //-----------------------------------------------------------------------------------------------
+   void arm(const Pattern& pattern, Action action);
+
+
+   /// Number of times any pattern has matched.
+   unsigned long matches() const { return _matches; }
+
+   /// Number of transitions which arrived after a later transition had advanced a partial match.
+   unsigned long late() const { return _late; }
+
+
+   // GPIO::EdgeSink
+   void onEdge(unsigned short id, GPIO::Value value, GPIO::TimePoint when) override;
+
+private:
+   // A single step of a compiled pattern. A transition matches a step if it occurs on GPIO id and
+   // its value is one of the values in the mask.
+   struct State
+   {
+      unsigned short  id;
+      unsigned char   valueMask;
+      GPIO::Clock::duration within;
+   };
+
+   struct Compiled
+   {
+      std::vector<State> states;
+      Action             action;
+
+      // Evaluation state, guarded by mutex since several detection threads may feed one pattern.
+      // Not a spin lock: those threads may run at different real-time priorities on one core, and
+      // a spinning higher priority thread would never let the holder finish.
+      std::mutex         mutex;
+      std::size_t        current;
+      GPIO::TimePoint    last;
+   };
+
+   static bool accepts(const State& state, unsigned short id, unsigned char valueBit)
+   { return state.id == id && (state.valueMask & valueBit) != 0; }
+
+private:
+   std::vector<std::unique_ptr<Compiled>> _patterns;
+   std::atomic<unsigned long>             _matches{0};
+   std::atomic<unsigned long>             _late{0};
+};
+
+#endif
@@ -1,3 +1,6 @@
+#ifndef UNCOPYABLE_HH
+#define UNCOPYABLE_HH
+
 class Uncopyable
 {
 protected:
@@ -8,4 +11,6 @@ private:
    Uncopyable& operator=(const Uncopyable&) = delete;
    Uncopyable(Uncopyable&&)                 = delete;
    Uncopyable& operator=(Uncopyable&&)      = delete;
-};
\ No newline at end of file
+};
+
+#endif
@@ -0,0 +1,138 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2014 Thomas Mercier Jr.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+//--------------------------------------------------------------------------------------------------
+// Cost of setting a bank of N outputs: setValue() on each output in turn, against one setValues()
+// call, with the outputs written by the caller and by their chip's writer thread (setAsync()).
+// Each round sets every output to the opposite of its previous value.
+//
+// Usage: setvalues <first GPIO> <pins> [rounds]
+//
+// The GPIOs first .. first + pins - 1 must be free to export as outputs. On an I/O expander every
+// write is a bus transaction; a gpio-sim chip measures the software path alone:
+//    cd /sys/kernel/config/gpio-sim
+//    mkdir bench bench/bank0 && echo 64 > bench/bank0/num_lines && echo 1 > bench/live
+// <first GPIO> is then the base of the new chip (/sys/class/gpio/gpiochip<base>).
+//
+// With setAsync(), the time is that of the calling thread only; the writes complete later. The
+// number of values the writer coalesced shows how many writes were saved.
+//--------------------------------------------------------------------------------------------------
+
+#include "../GPIO.hh"
+#include "../ChipTable.hh"
+#include "../ExpanderWriter.hh"
+
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+
+namespace
+{
+   typedef std::chrono::duration<double, std::micro> Microseconds;
+
+   GPIO::Value level(unsigned round)
+   {
+      return (round % 2) ? GPIO::Value::HIGH : GPIO::Value::LOW;
+   }
+
+
+   Microseconds oneByOne(const std::vector<std::unique_ptr<GPIO>>& pins, unsigned rounds)
+   {
+      const GPIO::TimePoint start = GPIO::Clock::now();
+      for( unsigned r = 0; r < rounds; ++r )
+      {
+         for( const auto& pin : pins )
+            pin->setValue(level(r));
+      }
+      return (GPIO::Clock::now() - start) / rounds;
+   }
+
+
+   Microseconds asBank(const std::vector<std::unique_ptr<GPIO>>& pins, unsigned rounds)
+   {
+      std::vector<GPIO::Assignment> bank(pins.size());
+
+      const GPIO::TimePoint start = GPIO::Clock::now();
+      for( unsigned r = 0; r < rounds; ++r )
+      {
+         for( std::size_t i = 0; i < pins.size(); ++i )
+         {
+            bank[i].gpio  = pins[i].get();
+            bank[i].value = level(r);
+         }
+         GPIO::setValues(bank.data(), bank.size());
+      }
+      return (GPIO::Clock::now() - start) / rounds;
+   }
+
+
+   void report(const char* method, Microseconds perRound, std::size_t pins)
+   {
+      std::cout << std::setw(24) << method << std::fixed << std::setprecision(2)
+                << std::setw(14) << perRound.count()
+                << std::setw(14) << perRound.count() / pins << std::endl;
+   }
+}
+
+
+int main(int argc, char* argv[])
+{
+   const unsigned short first  = (argc >= 3) ? std::atoi(argv[1]) : 0;
+   const unsigned short count  = (argc >= 3) ? std::atoi(argv[2]) : 0;
+   const unsigned       rounds = (argc >= 4) ? std::atoi(argv[3]) : 1000;
+   if( count == 0 || rounds == 0 )
+   {
+      std::cerr << "Usage: " << argv[0] << " <first GPIO> <pins> [rounds]" << std::endl;
+      return EXIT_FAILURE;
+   }
+
+   std::vector<std::unique_ptr<GPIO>> pins;
+   for( unsigned short i = 0; i < count; ++i )
+      pins.emplace_back(new GPIO(first + i, GPIO::Direction::OUT));
+
+   std::cout << count << " outputs, " << rounds << " rounds" << std::endl;
+   std::cout << std::setw(24) << "method" << std::setw(14) << "us/round"
+             << std::setw(14) << "us/pin" << std::endl;
+
+   report("setValue()",  oneByOne(pins, rounds), count);
+   report("setValues()", asBank(pins, rounds),   count);
+
+   for( const auto& pin : pins )
+      pin->setAsync(true);
+   const ExpanderWriter& writer =
+      ExpanderWriter::forChip(ChipTable::instance().find(first).orRaise().name);
+   const unsigned long   before = writer.coalesced();
+
+   report("setValue(), async",  oneByOne(pins, rounds), count);
+   report("setValues(), async", asBank(pins, rounds),   count);
+
+   std::cout << "Values coalesced by the writer: " << writer.coalesced() - before << " of "
+             << 2ul * rounds * count << std::endl;
+
+   return EXIT_SUCCESS;
+}
@@ -0,0 +1,113 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2014 Thomas Mercier Jr.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+//--------------------------------------------------------------------------------------------------
+// Teardown time versus pin count: N input GPIOs (each with its detection and callback threads)
+// destroyed one at a time, against the same N torn down together by PinGroup::shutdown().
+//
+// Usage: teardown <first GPIO> <max pins>
+//
+// The GPIOs first .. first + max - 1 must be free to export and able to detect transitions. A
+// gpio-sim chip serves:
+//    cd /sys/kernel/config/gpio-sim
+//    mkdir bench bench/bank0 && echo 64 > bench/bank0/num_lines && echo 1 > bench/live
+// <first GPIO> is then the base of the new chip (/sys/class/gpio/gpiochip<base>).
+//--------------------------------------------------------------------------------------------------
+
+#include "../GPIO.hh"
+#include "../PinGroup.hh"
+
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+
+namespace
+{
+   typedef std::chrono::duration<double, std::milli> Milliseconds;
+
+   void ignore(GPIO::Value) {}
+
+
+   Milliseconds oneAtATime(unsigned short first, unsigned short count)
+   {
+      std::vector<std::unique_ptr<GPIO>> pins;
+      for( unsigned short i = 0; i < count; ++i )
+         pins.emplace_back(new GPIO(first + i, GPIO::Edge::BOTH, ignore));
+
+      const GPIO::TimePoint start = GPIO::Clock::now();
+      for( auto& pin : pins )
+         pin.reset();
+      return GPIO::Clock::now() - start;
+   }
+
+
+   Milliseconds together(unsigned short first, unsigned short count)
+   {
+      PinGroup group;
+      for( unsigned short i = 0; i < count; ++i )
+         group.add(first + i, GPIO::Edge::BOTH, ignore);
+
+      const GPIO::TimePoint start = GPIO::Clock::now();
+      group.shutdown();
+      return GPIO::Clock::now() - start;
+   }
+}
+
+
+int main(int argc, char* argv[])
+{
+   const unsigned short first = (argc == 3) ? std::atoi(argv[1]) : 0;
+   const unsigned short max   = (argc == 3) ? std::atoi(argv[2]) : 0;
+   if( max == 0 )
+   {
+      std::cerr << "Usage: " << argv[0] << " <first GPIO> <max pins>" << std::endl;
+      return EXIT_FAILURE;
+   }
+
+   std::cout << std::setw(6) << "pins" << std::setw(16) << "one-at-a-time"
+             << std::setw(16) << "PinGroup" << "   (ms)" << std::endl;
+
+   // Powers of two, and max itself
+   std::vector<unsigned short> counts;
+   for( unsigned count = 1; count < max; count *= 2 )
+      counts.push_back(count);
+   counts.push_back(max);
+
+   for( const unsigned short count : counts )
+   {
+      const Milliseconds serial   = oneAtATime(first, count);
+      const Milliseconds parallel = together(first, count);
+
+      std::cout << std::fixed << std::setprecision(3)
+                << std::setw(6)  << count
+                << std::setw(16) << serial.count()
+                << std::setw(16) << parallel.count() << std::endl;
+   }
+
+   return EXIT_SUCCESS;
+}
@@ -0,0 +1,239 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2014 Thomas Mercier Jr.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+//--------------------------------------------------------------------------------------------------
+// Checks that the steady state of a GPIO allocates no heap memory: a million transitions through
+// the detection path (GPIO::handleEvents(), the glitch filter, GPIO::deliver(), an EdgeSink, the
+// event queue, and GPIO::isrLoop() calling the callback function), and a million setValue() and
+// getValue() calls.
+//
+// malloc() and operator new are replaced by counting versions. GPIOTest builds GPIOs through the
+// private constructor, which leaves sysfs alone, and gives them a memfd in place of the sysfs
+// value file. The test thread plays the part of _pollThread: it writes a new level to the memfd
+// and has handleEvents() handle it as if poll() had reported POLLPRI.
+//
+// Exits with status 0 if no allocation was counted.
+//--------------------------------------------------------------------------------------------------
+
+#include "../GPIO.hh"
+
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <thread>
+
+#include <poll.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+
+//--------------------------------------------------------------------------------------------------
+// Allocation counting
+//--------------------------------------------------------------------------------------------------
+
+namespace
+{
+   std::atomic<bool>          counting(false);
+   std::atomic<unsigned long> allocations(0);
+
+   void count()
+   {
+      if( counting.load(std::memory_order_relaxed) )
+         allocations.fetch_add(1, std::memory_order_relaxed);
+   }
+}
+
+extern "C"
+{
+   void* __libc_malloc(std::size_t size);
+   void* __libc_calloc(std::size_t n, std::size_t size);
+   void* __libc_realloc(void* p, std::size_t size);
+   void  __libc_free(void* p);
+
+   void* malloc(std::size_t size)                 { count(); return __libc_malloc(size); }
+   void* calloc(std::size_t n, std::size_t size)  { count(); return __libc_calloc(n, size); }
+   void* realloc(void* p, std::size_t size)       { count(); return __libc_realloc(p, size); }
+   void  free(void* p)                            { __libc_free(p); }
+}
+
+// Also counted directly, in case operator new does not go through malloc()
+void* operator new(std::size_t size)
+{
+   count();
+   void* const p = __libc_malloc(size ? size : 1);
+   if( p == nullptr )
+      throw std::bad_alloc();
+   return p;
+}
+
+void* operator new[](std::size_t size)                      { return operator new(size); }
+void  operator delete(void* p) noexcept                     { __libc_free(p); }
+void  operator delete[](void* p) noexcept                   { __libc_free(p); }
+void  operator delete(void* p, std::size_t) noexcept        { __libc_free(p); }
+void  operator delete[](void* p, std::size_t) noexcept      { __libc_free(p); }
+
+
+//--------------------------------------------------------------------------------------------------
+// Test seam
+//--------------------------------------------------------------------------------------------------
+
+class GPIOTest
+{
+public:
+   // An input detecting edge, with value file fd, and its callback thread running
+   static GPIO* input(unsigned short id, GPIO::Edge edge, std::function<void(GPIO::Value)> isr,
+                      GPIO::EdgeSink& sink, int fd)
+   {
+      GPIO* const gpio = new GPIO(id, GPIO::Direction::IN, edge,
+                                  new GPIO::Handlers(isr, &sink), GPIO::Mode::THREADS);
+      gpio->_pollFD = fd;
+      if( pipe(gpio->_pipeFD) != 0 )
+      {
+         perror("pipe");
+         std::exit(EXIT_FAILURE);
+      }
+      gpio->_isrThread = std::thread(&GPIO::isrLoop, gpio);
+      return gpio;
+   }
+
+   // An output with value file fd
+   static GPIO* output(unsigned short id, int fd)
+   {
+      GPIO* const gpio = new GPIO(id, GPIO::Direction::OUT, GPIO::Edge::NONE,
+                                  new GPIO::Handlers(), GPIO::Mode::THREADS);
+      gpio->_valueFD = fd;
+      return gpio;
+   }
+
+   // What _pollThread does when poll() reports a transition
+   static void edge(GPIO& gpio)
+   {
+      struct pollfd fdset[2];
+      gpio.initPollSet(fdset);
+      fdset[0].revents = POLLPRI;
+      gpio.handleEvents(fdset, GPIO::Clock::now());
+   }
+};
+
+
+namespace
+{
+   const unsigned long EDGES   = 1000000;
+   const unsigned long WARM_UP = 1000;
+
+   std::atomic<unsigned long> callbacks(0);
+
+   void onEdge(GPIO::Value) { ++callbacks; }
+
+   class CountingSink : public GPIO::EdgeSink
+   {
+   public:
+      CountingSink() : edges(0) {}
+      void onEdge(unsigned short, GPIO::Value, GPIO::TimePoint) override { ++edges; }
+      std::atomic<unsigned long> edges;
+   };
+
+
+   int valueFile(const char* name)
+   {
+      const int fd = memfd_create(name, MFD_CLOEXEC);
+      if( fd < 0 || pwrite(fd, "0\n", 2, 0) != 2 )
+      {
+         perror("memfd_create");
+         std::exit(EXIT_FAILURE);
+      }
+      return fd;
+   }
+
+
+   // Transitions n .. end - 1, each followed by the opposite level
+   void transitions(GPIO& input, int fd, unsigned long n, unsigned long end)
+   {
+      for( ; n < end; ++n )
+      {
+         const char* const level = (n % 2) ? "0\n" : "1\n";
+         if( pwrite(fd, level, 2, 0) != 2 )
+         {
+            perror("pwrite");
+            std::exit(EXIT_FAILURE);
+         }
+         GPIOTest::edge(input);
+      }
+
+      // Let the callback thread catch up
+      while( callbacks < end )
+         std::this_thread::yield();
+   }
+}
+
+
+int main()
+{
+   CountingSink sink;
+   const int   inFD   = valueFile("in");
+   GPIO* const input  = GPIOTest::input(15, GPIO::Edge::BOTH, onEdge, sink, inFD);
+   GPIO* const output = GPIOTest::output(27, valueFile("out"));
+
+   // Anything allocated on first use (thread start-up, lazily initialized state) is not counted
+   transitions(*input, inFD, 0, WARM_UP);
+   output->setValue(GPIO::Value::HIGH);
+   output->getValue();
+
+   counting = true;
+   transitions(*input, inFD, WARM_UP, WARM_UP + EDGES);
+   unsigned long mismatches = 0;
+   for( unsigned long n = 0; n < EDGES; ++n )
+   {
+      const GPIO::Value value = (n % 2) ? GPIO::Value::LOW : GPIO::Value::HIGH;
+      output->setValue(value);
+      if( output->getValue() != value )
+         ++mismatches;
+   }
+   counting = false;
+
+   const unsigned long counted = allocations;
+   const bool delivered = (sink.edges == WARM_UP + EDGES && callbacks == WARM_UP + EDGES);
+
+   delete output;
+   delete input;
+
+   std::cout << EDGES << " transitions and " << EDGES << " setValue()/getValue() pairs: "
+             << counted << " allocations" << std::endl;
+
+   if( !delivered || mismatches != 0 )
+   {
+      std::cout << "FAILED: " << sink.edges << " transitions reached the sink and " << callbacks
+                << " the callback function, " << mismatches << " values read back wrong"
+                << std::endl;
+      return EXIT_FAILURE;
+   }
+   if( counted != 0 )
+   {
+      std::cout << "FAILED: the steady state allocated" << std::endl;
+      return EXIT_FAILURE;
+   }
+   std::cout << "PASSED" << std::endl;
+   return EXIT_SUCCESS;
+}
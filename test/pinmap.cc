@@ -0,0 +1,57 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2014 Thomas Mercier Jr.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+//--------------------------------------------------------------------------------------------------
+// Compile check of PinMap: instantiates every member for a map of outputs, inputs with and without
+// an edge, so that the templates are checked by every build of the tests. Nothing is run.
+//--------------------------------------------------------------------------------------------------
+
+#include "../PinMap.hh"
+
+
+// External linkage throughout, so that nothing below can be discarded unused
+void onButton(GPIO::Value) {}
+
+typedef PinMap<Pin<27, GPIO::Direction::OUT>,
+               Pin<15, GPIO::Direction::IN, GPIO::Edge::RISING, &onButton>,
+               Pin<14, GPIO::Direction::IN>> Map;
+
+static_assert(Map::size == 3, "PinMap size");
+static_assert(PinMapDetail::unique(27, 15, 14), "unique() accepts distinct IDs");
+static_assert(!PinMapDetail::unique(27, 15, 27), "unique() rejects a repeated ID");
+static_assert(PinMapDetail::indexOf(15, 0, 27, 15, 14) == 1, "indexOf() finds an ID");
+static_assert(PinMapDetail::indexOf(16, 0, 27, 15, 14) == ~std::size_t(0),
+              "indexOf() reports a missing ID");
+
+template class PinMap<Pin<27, GPIO::Direction::OUT>,
+                      Pin<15, GPIO::Direction::IN, GPIO::Edge::RISING, &onButton>,
+                      Pin<14, GPIO::Direction::IN>>;
+
+
+void usePinMap(Map& pins)
+{
+   pins.pin<27>().setValue(GPIO::Value::HIGH);
+   pins.pin<15>().pause();
+   pins[2].getValue();
+}